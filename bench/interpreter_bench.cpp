@@ -0,0 +1,205 @@
+// running long generated programs with each engine of --run, the bytecode is generated once and run many times
+// the closures are compiled by the constructor, that is timed apart from running them
+// ./interpreter_bench [statements in thousands]
+
+#include "../src/batch_interpreter.hpp"
+#include "../src/batch_runner.hpp"
+#include "../src/bytecode.hpp"
+#include "../src/closure_interpreter.hpp"
+#include "../src/interpreter.hpp"
+#include "../src/jit.hpp"
+#include "../src/lexer.hpp"
+#include "../src/parser.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+// straight line arithmetic with an if every few statements, some nested, like the programs we verify
+static std::string generate(size_t statements) {
+    std::string src;
+    size_t variables = 0;
+    auto name = [](size_t i) { return "v" + std::to_string(i); };
+    for (size_t i = 0; i < statements; i++) {
+        if (variables < 8 || i % 7 == 0) {
+            src += "int " + name(variables) + " = " + std::to_string(i % 251) + ";\n";
+            variables++;
+            continue;
+        }
+        std::string a = name(i % variables);
+        std::string b = name((i * 7 + 3) % variables);
+        std::string c = name((i * 13 + 5) % variables);
+        switch (i % 5) {
+            case 0:
+                src += a + " = " + b + " + " + c + " - " + std::to_string(i % 97) + ";\n";
+                break;
+            case 1:
+                src += a + " = " + a + " + 1;\n";
+                break;
+            case 2:
+                src += "if (" + a + " == " + b + ") {\n    " + c + " = " + c + " - " + a + ";\n    if (" + c + " == 3) {\n        " + b + " = 7;\n    }\n}\n";
+                break;
+            case 3:
+                src += a + " = (" + b + " - " + c + ") + (" + c + " == " + std::to_string(i % 256) + ");\n";
+                break;
+            case 4:
+                src += "if (" + a + " == " + std::to_string(i % 256) + ") {\n    " + b + " = " + a + ";\n}\n";
+                break;
+        }
+    }
+    return src;
+}
+
+static double milliseconds_since(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+template <typename run_t>
+static double best_of(int runs, run_t run) {
+    double best = 1e300;
+    for (int i = 0; i < runs; i++) {
+        auto start = std::chrono::steady_clock::now();
+        run();
+        best = std::min(best, milliseconds_since(start));
+    }
+    return best;
+}
+
+// the best of a few runs of the statements of a fresh interpreter, constructing it and get_state are timed apart
+template <typename interpreter_type_t>
+static void time_statements(sl::ast_view_t ast, sl::names_view_t symbols, double& construct, double& run, std::string& state) {
+    construct = run = 1e300;
+    for (int i = 0; i < 5; i++) {
+        auto start = std::chrono::steady_clock::now();
+        interpreter_type_t interpreter{ ast, symbols };
+        construct = std::min(construct, milliseconds_since(start));
+        start = std::chrono::steady_clock::now();
+        while (interpreter.can_run()) interpreter.run_statement();
+        run = std::min(run, milliseconds_since(start));
+        state = interpreter.get_state();
+    }
+}
+
+// one program of a few thousand statements over many initial states, at each level of batch_interpreter_t
+static bool bench_batch() {
+    constexpr size_t states = 16384;
+    std::string src = generate(4000);
+    sl::lexer_t lexer{ src };
+    sl::token_buffer_t tokens = lexer.tokens();
+    sl::parser_t parser{ tokens, src };
+    auto [ast, symbols] = parser.parse().take();
+    sl::bytecode_t bytecode = sl::bytecode_gen_t{ ast, symbols }.gen();
+
+    std::vector<uint8_t> initial(states * bytecode.variables);
+    for (size_t i = 0; i < initial.size(); i++) initial[i] = uint8_t(i * 2654435761u >> 13);
+    std::cout << "batch of " << states << " states, " << ast.statements.size() << " statements, " << bytecode.variables << " variables\n";
+
+    const char *names[] = { "scalar", "sse2", "avx2" };
+    std::vector<uint8_t> reference;
+    double scalar = 0;
+    for (sl::scan::level_t level : { sl::scan::level_t::e_scalar, sl::scan::level_t::e_sse2, sl::scan::level_t::e_avx2 }) {
+        if (level > sl::scan::best_level()) continue;
+        sl::batch_interpreter_t batch{ bytecode, level };
+        std::vector<uint8_t> final(initial.size());
+        double run = best_of(3, [&] { batch.run(initial.data(), final.data(), states); });
+        if (reference.empty()) {
+            reference = final;
+            scalar = run;
+        } else if (final != reference) {
+            std::cerr << "the levels of the batch interpreter disagree\n";
+            return false;
+        }
+        std::cout << "  " << names[int(level)] << ":\t" << run << " ms, " << run * 1e6 / states << " ns a state, " << scalar / run << "x\n";
+    }
+    return true;
+}
+
+// the same jobs on 1, 2, 4 ... threads up to the cores there are, programs of a few sizes in runs of jobs
+static bool bench_runner() {
+    constexpr size_t jobs_count = 32768;
+    std::vector<sl::program_t> programs;
+    for (size_t i = 0; i < 4; i++) programs.push_back(sl::load_program(generate(1000 + i * 1000)).take());
+
+    std::vector<sl::run_job_t> jobs;
+    std::vector<std::vector<uint8_t>> initial(jobs_count);
+    for (size_t i = 0; i < jobs_count; i++) {
+        const sl::program_t& program = programs[i / 300 % programs.size()];
+        initial[i].resize(program.variables());
+        for (size_t v = 0; v < initial[i].size(); v++) initial[i][v] = uint8_t((i + v) * 2654435761u >> 13);
+        jobs.push_back({ &program, initial[i].data() });
+    }
+    std::cout << "runner of " << jobs_count << " jobs over " << programs.size() << " programs\n";
+
+    std::vector<uint8_t> reference;
+    double one = 0;
+    size_t cores = std::max(1u, std::thread::hardware_concurrency());
+    std::vector<size_t> counts;
+    for (size_t threads = 1; threads < cores; threads *= 2) counts.push_back(threads);
+    counts.push_back(cores);
+    for (size_t threads : counts) {
+        sl::thread_pool_t pool{ threads };
+        sl::batch_runner_t runner{ pool };
+        std::vector<uint8_t> finals;
+        double run = best_of(3, [&] { runner.run(jobs, finals); });
+        if (reference.empty()) {
+            reference = finals;
+            one = run;
+        } else if (finals != reference) {
+            std::cerr << "the runner gives other states on " << threads << " threads\n";
+            return false;
+        }
+        std::cout << "  " << threads << " threads:\t" << run << " ms, " << jobs_count / run / 1e3 << "M states/s, " << one / run << "x\n";
+    }
+    return true;
+}
+
+int main(int argc, char **argv) {
+    size_t thousands = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 1000;
+    std::string src = generate(thousands * 1000);
+    sl::lexer_t lexer{ src };
+    sl::token_buffer_t tokens = lexer.tokens();
+    sl::parser_t parser{ tokens, src };
+    auto result = parser.parse();
+    if (!result) {
+        std::cerr << "generated program does not parse: " << result.unwrapErr().message(src) << '\n';
+        return EXIT_FAILURE;
+    }
+    auto [ast, symbols] = result.take();
+    std::cout << ast.statements.size() << " statements, " << ast.expressions.size() << " expressions, " << symbols.size() << " variables\n";
+
+    double tree_construct, tree_run, closure_compile, closure_run;
+    std::string tree_state, closure_state;
+    time_statements<sl::interpreter_t>(ast, symbols, tree_construct, tree_run, tree_state);
+    time_statements<sl::closure_interpreter_t>(ast, symbols, closure_compile, closure_run, closure_state);
+
+    sl::bytecode_t bytecode;
+    double gen = best_of(5, [&] { bytecode = sl::bytecode_gen_t{ ast, symbols }.gen(); });
+    sl::bytecode_vm_t vm{ bytecode, symbols };
+    double run = best_of(5, [&] { vm.run(); });
+    std::string bytecode_state;
+    double state = best_of(5, [&] { bytecode_state = vm.get_state(); });
+
+    double assemble = best_of(5, [&] { sl::jit_t{ bytecode, symbols }; });
+    sl::jit_t jit{ bytecode, symbols };
+    double jit_run = best_of(5, [&] { jit.run(); });
+    std::string jit_state = jit.get_state();
+    if (bytecode_state != tree_state || closure_state != tree_state || jit_state != tree_state) {
+        std::cerr << "the engines disagree\n";
+        return EXIT_FAILURE;
+    }
+
+    // get_state formats the same lines for every engine, it is timed on its own and left out of the runs
+    std::cout << "  tree:\t\t" << tree_run << " ms running\n";
+    std::cout << "  closure:\t" << closure_run << " ms running, " << closure_compile << " ms compiling\n";
+    std::cout << "  bytecode:\t" << run << " ms running, " << gen << " ms generating " << bytecode.code.size() << " instructions\n";
+    std::cout << "  jit:\t\t" << jit_run << " ms running, " << assemble << " ms assembling" << (jit.compiled() ? "\n" : " (not available, the bytecode vm ran)\n");
+    std::cout << "  get_state:\t" << state << " ms\n";
+    std::cout << "  speedup:\t" << tree_run / closure_run << "x closure, " << tree_run / (closure_compile + closure_run) << "x with compiling\n";
+    std::cout << "  \t\t" << tree_run / run << "x bytecode, " << tree_run / (gen + run) << "x with generating\n";
+    std::cout << "  \t\t" << tree_run / jit_run << "x jit, " << tree_run / (gen + assemble + jit_run) << "x with generating and assembling\n";
+    return bench_batch() && bench_runner() ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,304 @@
+// lexer throughput on a large generated program, once per scan level and once with the dfa engine, against the
+// lexer this started from as the baseline, and the streaming and parallel parsers checked against the in memory one
+// ./lexer_bench [size in MiB]
+
+#include "../src/ast_file.hpp"
+#include "../src/lexer.hpp"
+#include "../src/parallel_parser.hpp"
+#include "../src/parser.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <optional>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace baseline {
+
+// lexer_t as it was before the scanners and the token buffer, byte at a time with a std::string for every token
+struct token_t {
+    sl::token_type_t type;
+    std::string text;
+};
+
+class lexer_t {
+public:
+    explicit lexer_t(const std::string src) : _src(src) {}
+
+    token_t next() {
+        while (auto c = try_get()) {
+            if (isspace(*c)) {
+                _index++;
+                continue;
+            }
+            if (isalpha(*c)) {
+                std::string word{ *c };
+                _index++;
+                while (auto next = try_get()) {
+                    if (!isalnum(*next)) break;
+                    word += *next;
+                    _index++;
+                }
+                if (word == "if") return { sl::token_type_t::e_if, word };
+                if (word == "int") return { sl::token_type_t::e_int, word };
+                return { sl::token_type_t::e_identifier, word };
+            }
+            if (isdigit(*c)) {
+                std::string number{ *c };
+                _index++;
+                while (auto next = try_get()) {
+                    if (!isdigit(*next)) break;
+                    _index++;
+                    number += *next;
+                }
+                return { sl::token_type_t::e_number, number };
+            }
+            if (*c == '=') {
+                if (try_get(1) == '=') {
+                    _index += 2;
+                    return { sl::token_type_t::e_equal, "==" };
+                }
+                _index++;
+                return { sl::token_type_t::e_assign, std::string(1, *c) };
+            }
+            if (*c == '/') {
+                _index++;
+                while (auto next = try_get()) {
+                    if (*next == '\n') break;
+                    _index++;
+                }
+                continue;
+            }
+            std::optional<sl::token_type_t> type;
+            switch (*c) {
+                case '+': type = sl::token_type_t::e_plus; break;
+                case '-': type = sl::token_type_t::e_minus; break;
+                case '{': type = sl::token_type_t::e_lbrace; break;
+                case '}': type = sl::token_type_t::e_rbrace; break;
+                case '(': type = sl::token_type_t::e_lbracket; break;
+                case ')': type = sl::token_type_t::e_rbracket; break;
+                case ';': type = sl::token_type_t::e_semicolon; break;
+            }
+            if (!type) throw std::runtime_error(std::string("unexpected char ") + *c);
+            _index++;
+            return { *type, std::string(1, *c) };
+        }
+        return { sl::token_type_t::e_end, {} };
+    }
+
+    std::vector<token_t> tokens() {
+        std::vector<token_t> tokens;
+        while (true) {
+            token_t token = next();
+            if (token.type == sl::token_type_t::e_end) break;
+            tokens.push_back(token);
+        }
+        return tokens;
+    }
+
+private:
+    std::optional<char> try_get(uint32_t offset = 0) {
+        if (_index + offset >= _src.size()) return std::nullopt;
+        return _src[_index + offset];
+    }
+
+    std::string _src;
+    uint32_t _index{ 0 };
+};
+
+} // namespace baseline
+
+// long_runs indents deeply and uses long names and comments, like machine generated sources
+static std::string generate(size_t size, bool long_runs) {
+    std::string indent = long_runs ? std::string(24, ' ') : "    ";
+    std::string prefix = long_runs ? "generatedSignalRegisterValue" : "value";
+    std::string comment = long_runs ? std::string(80, '-') : "declare and give it a value";
+    std::string src;
+    src.reserve(size + 256);
+    size_t i = 0;
+    while (src.size() < size) {
+        std::string name = prefix + std::to_string(i);
+        src += "// " + comment + "\n";
+        src += "int " + name + " = " + std::to_string(i % 256) + ";\n";
+        src += "if (" + name + " == 42) {\n" + indent + name + " = " + name + " + 1234 - 7;\n}\n\n";
+        i++;
+    }
+    return src;
+}
+
+static double throughput(const std::string& src, sl::lexer_engine_t engine, sl::token_buffer_t& tokens) {
+    double best = 0;
+    for (int run = 0; run < 5; run++) {
+        auto start = std::chrono::steady_clock::now();
+        sl::lexer_t lexer{ src, engine };
+        tokens = lexer.tokens();
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        best = std::max(best, src.size() / elapsed.count() / (1024 * 1024));
+    }
+    return best;
+}
+
+static double baseline_throughput(const std::string& src, size_t& count) {
+    double best = 0;
+    for (int run = 0; run < 3; run++) {
+        auto start = std::chrono::steady_clock::now();
+        baseline::lexer_t lexer{ src };
+        count = lexer.tokens().size();
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        best = std::max(best, src.size() / elapsed.count() / (1024 * 1024));
+    }
+    return best;
+}
+
+static bool same_tokens(const sl::token_buffer_t& a, const sl::token_buffer_t& b) {
+    return a.types == b.types && a.offsets == b.offsets && a.lengths == b.lengths;
+}
+
+static int bench(const std::string& src) {
+    const std::pair<sl::scan::level_t, const char *> levels[] = {
+        { sl::scan::level_t::e_scalar, "scalar" },
+        { sl::scan::level_t::e_sse2, "sse2" },
+        { sl::scan::level_t::e_avx2, "avx2" },
+    };
+
+    size_t count = 0;
+    double baseline = baseline_throughput(src, count);
+    std::cout << "  baseline:\t" << baseline << " MB/s (" << count << " tokens)\n";
+
+    sl::token_buffer_t expected;
+    sl::token_buffer_t tokens;
+    for (auto [level, name] : levels) {
+        if (level > sl::scan::best_level()) continue;
+        sl::scan::set_level(level);
+        double best = throughput(src, sl::lexer_engine_t::e_hand_written, tokens);
+        if (expected.size() && !same_tokens(tokens, expected)) {
+            std::cerr << name << " tokens differ from the scalar lexer\n";
+            return EXIT_FAILURE;
+        }
+        if (!expected.size() && tokens.size() != count) {
+            std::cerr << "the lexer gives " << tokens.size() << " tokens, the baseline " << count << "\n";
+            return EXIT_FAILURE;
+        }
+        expected = std::move(tokens);
+        std::cout << "  " << name << ":\t" << best << " MB/s (" << expected.size() << " tokens), " << best / baseline << "x\n";
+    }
+
+    double best = throughput(src, sl::lexer_engine_t::e_dfa, tokens);
+    if (!same_tokens(tokens, expected)) {
+        std::cerr << "dfa tokens differ from the hand written lexer\n";
+        return EXIT_FAILURE;
+    }
+    std::cout << "  dfa:\t" << best << " MB/s (" << tokens.size() << " tokens), " << best / baseline << "x\n";
+    return EXIT_SUCCESS;
+}
+
+// the ast file of the program, or the error, so the two parsers can be compared byte for byte
+template <typename parser_type_t>
+static std::string parse_outcome(parser_type_t& parser) {
+    try {
+        auto result = parser.parse();
+        if (!result) return "error " + result.unwrapErr().message();
+        auto [ast, symbols] = result.take();
+        return sl::write_ast(ast, symbols);
+    } catch (const std::runtime_error& error) {
+        return std::string("throws ") + error.what();
+    }
+}
+
+static std::string parse_buffered(const std::string& src) {
+    try {
+        sl::lexer_t lexer{ src };
+        sl::token_buffer_t tokens = lexer.tokens();
+        sl::parser_t parser{ tokens, src };
+        return parse_outcome(parser);
+    } catch (const std::runtime_error& error) {
+        return std::string("throws ") + error.what();
+    }
+}
+
+static std::string parse_streamed(const std::string& src, size_t chunk_size) {
+    std::istringstream input{ src };
+    sl::stream_lexer_t lexer{ input, chunk_size };
+    sl::stream_parser_t parser{ lexer };
+    return parse_outcome(parser);
+}
+
+static std::string parse_parallel(const std::string& src, sl::thread_pool_t& pool, size_t chunk_tokens) {
+    try {
+        sl::lexer_t lexer{ src };
+        sl::token_buffer_t tokens = lexer.tokens();
+        sl::parallel_parser_t parser{ tokens, src, pool, chunk_tokens };
+        return parse_outcome(parser);
+    } catch (const std::runtime_error& error) {
+        return std::string("throws ") + error.what();
+    }
+}
+
+// programs and broken sources the other parsers have to agree with parser_t on
+static std::vector<std::string> parser_cases(const std::string& program) {
+    // a } after an expression ends it and leaves the block open, -j > 1 used to close the block there
+    std::string open_block = "int a;\n";
+    for (int i = 0; i < 16383; i++) open_block += "a = 1;\n";
+    open_block += "if (a) { a = 1 }\na = 2;\n}\na = 3;\n";
+    return {
+        program,
+        open_block,
+        "int a = 1; // comment\nint b = (a == 1) + 23;\nif (a == b) { a = a - 1; }",
+        "int a; if (a) { a = 1 } a = 2; } a = 3; if (a) { } int b = a }",
+        "int a;\nb = 1;",
+        "int a = 99999999999999999999;",
+        "int a = (1 + 2;",
+        "int a; int a;",
+        "if (1) { int x = 2; } }",
+        "int a; a = 1; } a = 2;",
+        "int a; if (a) { a = 1; a = 2;",
+        "int a = 1 $ 2;",
+        "int value = 12",
+    };
+}
+
+// tokens and comments split across every chunk boundary give the same ast, or the same error at the same offset
+static bool check_stream(const std::vector<std::string>& sources) {
+    for (const std::string& src : sources) {
+        std::string expected = parse_buffered(src);
+        for (size_t chunk_size : { 1, 2, 3, 7, 64, 4096 }) {
+            if (parse_streamed(src, chunk_size) != expected) {
+                std::cerr << "stream_parser_t with " << chunk_size << " byte chunks differs from parser_t on " << src.substr(0, 40) << "\n";
+                return false;
+            }
+        }
+    }
+    std::cout << "stream parser agrees with the in memory parser\n";
+    return true;
+}
+
+// chunks of every size down to single statements give the same ast, or the same error at the same offset
+static bool check_parallel(const std::vector<std::string>& sources) {
+    sl::thread_pool_t pool{ 4 };
+    for (const std::string& src : sources) {
+        std::string expected = parse_buffered(src);
+        for (size_t chunk_tokens : { 1, 3, 16, 1024, 64 * 1024 }) {
+            if (parse_parallel(src, pool, chunk_tokens) != expected) {
+                std::cerr << "parallel_parser_t with " << chunk_tokens << " token chunks differs from parser_t on " << src.substr(0, 40) << "\n";
+                return false;
+            }
+        }
+    }
+    std::cout << "parallel parser agrees with the in memory parser\n";
+    return true;
+}
+
+int main(int argc, char **argv) {
+    size_t megabytes = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 64;
+    for (bool long_runs : { false, true }) {
+        std::cout << (long_runs ? "long runs\n" : "short runs\n");
+        if (bench(generate(megabytes * 1024 * 1024, long_runs)) != EXIT_SUCCESS) return EXIT_FAILURE;
+    }
+    std::vector<std::string> cases = parser_cases(generate(256 * 1024, true));
+    if (!check_stream(cases) || !check_parallel(cases)) return EXIT_FAILURE;
+    return 0;
+}
@@ -0,0 +1,250 @@
+#ifndef AST_FILE_HPP
+#define AST_FILE_HPP
+
+// binary ast files, so tools that run over the same program one after the other parse it once
+// the file is the arrays of ast_t as they are in memory, so a mapped file is walked in place through ast_view_t
+//   header       ast_file_header_t
+//   statements   statement_count statement_t
+//   expressions  expression_count expression_t
+//   offsets      symbol_count + 1 uint32_t, name id is chars[offsets[id], offsets[id + 1])
+//   chars        the names back to back
+// every section starts 8 byte aligned at the offset in the header, nodes refer to each other by index only,
+// the file is written in the byte order of the machine and is rejected by one with the other order
+
+#include "parser.hpp"
+#include "utility.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace sl {
+
+inline constexpr char ast_file_magic[8] = { '\x7f', 'S', 'L', 'A', 'S', 'T', '\n', '\0' };
+
+// bump with any change to the layout below or to statement_t and expression_t
+inline constexpr uint32_t ast_file_version = 1;
+
+struct ast_file_header_t {
+    char magic[8];
+    uint32_t version;
+    uint32_t byte_order;  // 0x01020304 as written
+    uint32_t statement_count;
+    uint32_t expression_count;
+    uint32_t symbol_count;
+    uint32_t reserved;
+    uint64_t statements_offset;
+    uint64_t expressions_offset;
+    uint64_t offsets_offset;
+    uint64_t chars_offset;
+    uint64_t chars_size;
+};
+
+static_assert(sizeof(ast_file_header_t) == 72);
+static_assert(offsetof(statement_t, id) == 4 && offsetof(statement_t, expression) == 8 && offsetof(statement_t, end) == 12);
+static_assert(offsetof(expression_t, op) == 1 && offsetof(expression_t, as) == 4);
+
+// whether bytes start like an ast file, the magic is not valid source so a source is never taken for one
+inline bool is_ast_file(std::string_view bytes) {
+    return bytes.size() >= sizeof(ast_file_magic) && std::memcmp(bytes.data(), ast_file_magic, sizeof(ast_file_magic)) == 0;
+}
+
+// the ast and its names as an ast file, the padding of the nodes is written as zeros so equal asts give equal files
+inline std::string write_ast(const ast_t& ast, const symbol_table_t& symbols) {
+    auto align = [](uint64_t offset) { return (offset + 7) & ~uint64_t(7); };
+
+    ast_file_header_t header{};
+    std::memcpy(header.magic, ast_file_magic, sizeof(header.magic));
+    header.version = ast_file_version;
+    header.byte_order = 0x01020304;
+    header.statement_count = ast.statements.size();
+    header.expression_count = ast.expressions.size();
+    header.symbol_count = symbols.size();
+    header.statements_offset = align(sizeof(header));
+    header.expressions_offset = align(header.statements_offset + ast.statements.size() * sizeof(statement_t));
+    header.offsets_offset = align(header.expressions_offset + ast.expressions.size() * sizeof(expression_t));
+    header.chars_offset = align(header.offsets_offset + (symbols.size() + 1) * sizeof(uint32_t));
+    for (uint32_t id = 0; id < symbols.size(); id++) {
+        header.chars_size += symbols.name(id).size();
+    }
+
+    std::string file(header.chars_offset + header.chars_size, '\0');
+    std::memcpy(file.data(), &header, sizeof(header));
+
+    char *statements = file.data() + header.statements_offset;
+    for (const statement_t& statement : ast.statements) {
+        statement_t copy;
+        std::memset(&copy, 0, sizeof(copy));
+        copy.type = statement.type;
+        copy.id = statement.id;
+        copy.expression = statement.expression;
+        copy.end = statement.end;
+        std::memcpy(statements, &copy, sizeof(copy));
+        statements += sizeof(copy);
+    }
+
+    char *expressions = file.data() + header.expressions_offset;
+    for (const expression_t& expression : ast.expressions) {
+        expression_t copy;
+        std::memset(&copy, 0, sizeof(copy));
+        copy.type = expression.type;
+        if (expression.type == expression_type_t::e_binary) {
+            copy.op = expression.op;
+            copy.as.binary = expression.as.binary;
+        } else {
+            copy.as.id = expression.as.id;  // or number, same bits
+        }
+        std::memcpy(expressions, &copy, sizeof(copy));
+        expressions += sizeof(copy);
+    }
+
+    char *offsets = file.data() + header.offsets_offset;
+    char *chars = file.data() + header.chars_offset;
+    uint32_t offset = 0;
+    for (uint32_t id = 0; id <= symbols.size(); id++) {
+        std::memcpy(offsets + id * sizeof(uint32_t), &offset, sizeof(offset));
+        if (id == symbols.size()) break;
+        std::string_view name = symbols.name(id);
+        std::memcpy(chars + offset, name.data(), name.size());
+        offset += name.size();
+    }
+    return file;
+}
+
+// an ast file viewed in place, nothing is copied, the bytes must stay alive and 8 byte aligned (as mmap and
+// the allocators give them) for as long as the view is used
+class ast_file_view_t {
+public:
+    // checks the header and that the sections lie within bytes, throws when they do not
+    explicit ast_file_view_t(std::string_view bytes) {
+        if (!is_ast_file(bytes) || bytes.size() < sizeof(ast_file_header_t)) throw std::runtime_error("not an ast file");
+        if (reinterpret_cast<uintptr_t>(bytes.data()) % alignof(uint64_t)) throw std::runtime_error("ast file is not 8 byte aligned in memory");
+        std::memcpy(&_header, bytes.data(), sizeof(_header));
+        if (_header.byte_order != 0x01020304) throw std::runtime_error("ast file written with the other byte order");
+        if (_header.version != ast_file_version) {
+            throw std::runtime_error("ast file version " + std::to_string(_header.version) + ", expected " + std::to_string(ast_file_version));
+        }
+
+        check_section(bytes, _header.statements_offset, uint64_t(_header.statement_count) * sizeof(statement_t));
+        check_section(bytes, _header.expressions_offset, uint64_t(_header.expression_count) * sizeof(expression_t));
+        check_section(bytes, _header.offsets_offset, (uint64_t(_header.symbol_count) + 1) * sizeof(uint32_t));
+        check_section(bytes, _header.chars_offset, _header.chars_size);
+
+        const char *data = bytes.data();
+        _statements = reinterpret_cast<const statement_t *>(data + _header.statements_offset);
+        _expressions = reinterpret_cast<const expression_t *>(data + _header.expressions_offset);
+        _offsets = reinterpret_cast<const uint32_t *>(data + _header.offsets_offset);
+        _chars = data + _header.chars_offset;
+    }
+
+    ast_view_t ast() const {
+        return { { _statements, _header.statement_count }, { _expressions, _header.expression_count } };
+    }
+
+    names_view_t names() const {
+        return { _offsets, _chars, _header.symbol_count };
+    }
+
+    // one pass over the nodes, after it every index the interpreter and code gen follow is in bounds
+    // files written by write_ast pass, run it on files that may be damaged or come from elsewhere
+    void verify() const {
+        for (uint32_t i = 0; i < _header.symbol_count; i++) {
+            if (_offsets[i] > _offsets[i + 1]) corrupt("name offsets");
+        }
+        if (_offsets[0] != 0 || _offsets[_header.symbol_count] > _header.chars_size) corrupt("name offsets");
+
+        // the expressions are a forest, an interpreter builds one node per expression and a walk over a shared child doubles with every level
+        std::vector<bool> referenced(_header.expression_count, false);
+        auto reference = [&](uint32_t index, const char *what) {
+            if (referenced[index]) corrupt(what);
+            referenced[index] = true;
+        };
+
+        for (uint32_t i = 0; i < _header.expression_count; i++) {
+            const expression_t& expression = _expressions[i];
+            switch (expression.type) {
+                case expression_type_t::e_identifier:
+                    if (expression.as.id >= _header.symbol_count) corrupt("identifier");
+                    break;
+                case expression_type_t::e_number:
+                    break;
+                case expression_type_t::e_binary:
+                    // children come first, so the recursion over them ends
+                    if (expression.as.binary.left >= i || expression.as.binary.right >= i) corrupt("operand");
+                    if (expression.op > op_t::e_equal) corrupt("operator");
+                    if (expression.op == op_t::e_assign && _expressions[expression.as.binary.left].type != expression_type_t::e_identifier) corrupt("assignment");
+                    reference(expression.as.binary.left, "operand");
+                    reference(expression.as.binary.right, "operand");
+                    break;
+                default:
+                    corrupt("expression type");
+            }
+        }
+
+        for (uint32_t i = 0; i < _header.statement_count; i++) {
+            const statement_t& statement = _statements[i];
+            bool has_expression = statement.expression != ast_t::npos;
+            if (has_expression && statement.expression >= _header.expression_count) corrupt("statement expression");
+            if (has_expression) reference(statement.expression, "statement expression");
+            switch (statement.type) {
+                case statement_type_t::e_declaration:
+                    if (statement.id >= _header.symbol_count) corrupt("declaration");
+                    break;
+                case statement_type_t::e_expression:
+                    if (!has_expression) corrupt("statement expression");
+                    break;
+                case statement_type_t::e_if:
+                    if (!has_expression || statement.end <= i || statement.end > _header.statement_count) corrupt("if");
+                    break;
+                default:
+                    corrupt("statement type");
+            }
+        }
+    }
+
+private:
+    static void check_section(std::string_view bytes, uint64_t offset, uint64_t size) {
+        if (offset % 8 || offset > bytes.size() || size > bytes.size() - offset) throw std::runtime_error("ast file is truncated");
+    }
+
+    [[noreturn]] static void corrupt(const char *what) {
+        throw std::runtime_error(std::string("corrupt ast file: bad ") + what);
+    }
+
+private:
+    ast_file_header_t _header;
+    const statement_t *_statements;
+    const expression_t *_expressions;
+    const uint32_t *_offsets;
+    const char *_chars;
+};
+
+// an ast file mapped from disk, for tools that start from the ast instead of the source
+class mapped_ast_t {
+public:
+    // throws when the file cannot be read or is not an ast file, verify says whether to check every node too
+    explicit mapped_ast_t(const std::filesystem::path& path, bool verify = true) : _source(path), _view(_source.view()) {
+        if (verify) _view.verify();
+    }
+
+    ast_view_t ast() const {
+        return _view.ast();
+    }
+
+    names_view_t names() const {
+        return _view.names();
+    }
+
+private:
+    source_t _source;
+    ast_file_view_t _view;
+};
+
+} // namespace sl
+
+#endif
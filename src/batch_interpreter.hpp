@@ -0,0 +1,266 @@
+#ifndef BATCH_INTERPRETER_HPP
+#define BATCH_INTERPRETER_HPP
+
+// runs one program over many initial states at once, for sweeping the inputs of a program
+// the states are run in groups of 64 (avx2) or 16 (sse2) lanes, picked at runtime like the lexer scans, or one
+// at a time without them; a register of the bytecode holds its byte of every lane of the group, so an
+// instruction is a vector operation or two, and an if narrows a mask of the lanes that run its body instead of jumping,
+// the whole group jumps only when no lane enters the body
+// the initial state of a lane gives every variable its value before the program runs, a declaration with a
+// value overwrites it, so the inputs of a program are the variables it declares without one
+
+#include "bytecode.hpp"
+#include "scan.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+namespace sl {
+
+namespace lanes {
+
+// the kernels read and write the bytes of width lanes in place, a mask has every bit of a lane set or clear
+// the lanes of a test are none, all of the mask or only some of them
+
+enum class test_t : uint8_t {
+    e_none,
+    e_all,
+    e_some,
+};
+
+struct scalar_t {
+    static constexpr uint32_t width = 1;
+
+    static void splat(uint8_t *out, uint8_t c) { *out = c; }
+    static void add(uint8_t *out, const uint8_t *a, const uint8_t *b) { *out = *a + *b; }
+    static void sub(uint8_t *out, const uint8_t *a, const uint8_t *b) { *out = *a - *b; }
+    static void equal(uint8_t *out, const uint8_t *a, const uint8_t *b) { *out = *a == *b; }
+    static void blend(uint8_t *out, const uint8_t *value, const uint8_t *mask) { *out = (*out & ~*mask) | (*value & *mask); }
+
+    // the lanes of mask where a is not zero, into out
+    static test_t nonzero(uint8_t *out, const uint8_t *a, const uint8_t *mask) {
+        *out = *a ? *mask : 0;
+        return *out ? test_t::e_all : test_t::e_none;
+    }
+};
+
+#ifdef SL_SCAN_X86
+
+struct sse2_t {
+    static constexpr uint32_t width = 16;
+
+    static __m128i load(const uint8_t *p) { return _mm_loadu_si128(reinterpret_cast<const __m128i *>(p)); }
+    static void store(uint8_t *p, __m128i v) { _mm_storeu_si128(reinterpret_cast<__m128i *>(p), v); }
+
+    static void splat(uint8_t *out, uint8_t c) { store(out, _mm_set1_epi8(char(c))); }
+    static void add(uint8_t *out, const uint8_t *a, const uint8_t *b) { store(out, _mm_add_epi8(load(a), load(b))); }
+    static void sub(uint8_t *out, const uint8_t *a, const uint8_t *b) { store(out, _mm_sub_epi8(load(a), load(b))); }
+    static void equal(uint8_t *out, const uint8_t *a, const uint8_t *b) {
+        store(out, _mm_and_si128(_mm_cmpeq_epi8(load(a), load(b)), _mm_set1_epi8(1)));
+    }
+    static void blend(uint8_t *out, const uint8_t *value, const uint8_t *mask) {
+        __m128i m = load(mask);
+        store(out, _mm_or_si128(_mm_and_si128(m, load(value)), _mm_andnot_si128(m, load(out))));
+    }
+
+    static test_t nonzero(uint8_t *out, const uint8_t *a, const uint8_t *mask) {
+        __m128i m = load(mask);
+        __m128i entering = _mm_andnot_si128(_mm_cmpeq_epi8(load(a), _mm_setzero_si128()), m);
+        store(out, entering);
+        if (_mm_movemask_epi8(entering) == 0) return test_t::e_none;
+        return _mm_movemask_epi8(_mm_cmpeq_epi8(entering, m)) == 0xffff ? test_t::e_all : test_t::e_some;
+    }
+};
+
+#define SL_AVX2 __attribute__((target("avx2")))
+
+// two vectors to a kernel, the registers of a group of 64 lanes still fit in the l1 of programs of a few hundred
+// variables and the dispatch of each instruction is shared by twice the lanes
+struct avx2_t {
+    static constexpr uint32_t width = 64;
+
+    SL_AVX2 static __m256i load(const uint8_t *p) { return _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p)); }
+    SL_AVX2 static void store(uint8_t *p, __m256i v) { _mm256_storeu_si256(reinterpret_cast<__m256i *>(p), v); }
+
+    SL_AVX2 static void splat(uint8_t *out, uint8_t c) {
+        store(out, _mm256_set1_epi8(char(c)));
+        store(out + 32, _mm256_set1_epi8(char(c)));
+    }
+    SL_AVX2 static void add(uint8_t *out, const uint8_t *a, const uint8_t *b) {
+        for (int i = 0; i < 64; i += 32) store(out + i, _mm256_add_epi8(load(a + i), load(b + i)));
+    }
+    SL_AVX2 static void sub(uint8_t *out, const uint8_t *a, const uint8_t *b) {
+        for (int i = 0; i < 64; i += 32) store(out + i, _mm256_sub_epi8(load(a + i), load(b + i)));
+    }
+    SL_AVX2 static void equal(uint8_t *out, const uint8_t *a, const uint8_t *b) {
+        for (int i = 0; i < 64; i += 32) store(out + i, _mm256_and_si256(_mm256_cmpeq_epi8(load(a + i), load(b + i)), _mm256_set1_epi8(1)));
+    }
+    SL_AVX2 static void blend(uint8_t *out, const uint8_t *value, const uint8_t *mask) {
+        for (int i = 0; i < 64; i += 32) store(out + i, _mm256_blendv_epi8(load(out + i), load(value + i), load(mask + i)));
+    }
+
+    SL_AVX2 static test_t nonzero(uint8_t *out, const uint8_t *a, const uint8_t *mask) {
+        uint64_t entering = 0, same = 0;
+        for (int i = 0; i < 64; i += 32) {
+            __m256i m = load(mask + i);
+            __m256i e = _mm256_andnot_si256(_mm256_cmpeq_epi8(load(a + i), _mm256_setzero_si256()), m);
+            store(out + i, e);
+            entering |= uint64_t(uint32_t(_mm256_movemask_epi8(e))) << i;
+            same |= uint64_t(uint32_t(_mm256_movemask_epi8(_mm256_cmpeq_epi8(e, m)))) << i;
+        }
+        if (!entering) return test_t::e_none;
+        return ~same ? test_t::e_some : test_t::e_all;
+    }
+};
+
+#endif
+
+} // namespace lanes
+
+class batch_interpreter_t {
+public:
+    explicit batch_interpreter_t(const bytecode_t& bytecode, scan::level_t level = scan::best_level())
+      : _bytecode(bytecode), _level(std::min(level, scan::best_level())) {}
+
+    // the size of a state, its values are by symbol id
+    uint32_t variables() const {
+        return _bytecode.variables;
+    }
+
+    // initial and final hold count states one after the other, final may be initial
+    void run(const uint8_t *initial, uint8_t *final, size_t count) {
+        switch (_level) {
+#ifdef SL_SCAN_X86
+            case scan::level_t::e_avx2:
+                run_avx2(initial, final, count);
+                break;
+            case scan::level_t::e_sse2:
+                run_lanes<lanes::sse2_t>(initial, final, count);
+                break;
+#endif
+            default:
+                run_lanes<lanes::scalar_t>(initial, final, count);
+                break;
+        }
+    }
+
+private:
+#ifdef SL_SCAN_X86
+    SL_AVX2 void run_avx2(const uint8_t *initial, uint8_t *final, size_t count) {
+        run_lanes<lanes::avx2_t>(initial, final, count);
+    }
+#endif
+
+    // inlined into run_avx2 so the kernels are compiled for avx2 there
+    template <typename lanes_t>
+    __attribute__((always_inline)) inline void run_lanes(const uint8_t *initial, uint8_t *final, size_t count) {
+        constexpr uint32_t width = lanes_t::width;
+        const uint32_t variables = _bytecode.variables;
+        _registers.assign(size_t(_bytecode.registers) * width, 0);
+        for (size_t first = 0; first < count; first += width) {
+            uint32_t group = uint32_t(std::min<size_t>(width, count - first));
+            // the lanes past the last state of a short group run on zeros and are dropped
+            for (uint32_t lane = 0; lane < width; lane++) {
+                for (uint32_t id = 0; id < variables; id++) {
+                    _registers[size_t(id) * width + lane] = lane < group ? initial[(first + lane) * variables + id] : 0;
+                }
+            }
+            run_group<lanes_t>();
+            for (uint32_t lane = 0; lane < group; lane++) {
+                uint8_t *state = final + (first + lane) * variables;
+                for (uint32_t id = 0; id < variables; id++) state[id] = _registers[size_t(id) * width + lane];
+            }
+        }
+    }
+
+    template <typename lanes_t>
+    __attribute__((always_inline)) inline void run_group() {
+        constexpr uint32_t width = lanes_t::width;
+        const uint32_t variables = _bytecode.variables;
+        uint8_t *r = _registers.data();
+        // the lanes that run are at _masks[depth], all of them but in the bodies of ifs not every lane entered
+        uint32_t depth = 0;
+        if (_masks.size() < width) _masks.resize(width);
+        std::fill(_masks.begin(), _masks.begin() + width, 0xff);
+
+        uint8_t value[width]{};
+        uint8_t constant[width]{};
+        const instruction_t *code = _bytecode.code.data();
+        for (uint32_t pc = 0;;) {
+            while (depth && _ends[depth - 1] == pc) depth--;
+            const instruction_t& i = code[pc++];
+            uint8_t *a = r + size_t(i.a) * width;
+            const uint8_t *b = r + size_t(i.b) * width;
+            const uint8_t *c = r + size_t(i.c) * width;
+            switch (i.op) {
+                case opcode_t::e_load:
+                    lanes_t::splat(value, uint8_t(i.b));
+                    break;
+                case opcode_t::e_move:
+                    std::copy(b, b + width, value);
+                    break;
+                case opcode_t::e_add:
+                    lanes_t::add(value, b, c);
+                    break;
+                case opcode_t::e_add_constant:
+                    lanes_t::splat(constant, uint8_t(i.c));
+                    lanes_t::add(value, b, constant);
+                    break;
+                case opcode_t::e_sub:
+                    lanes_t::sub(value, b, c);
+                    break;
+                case opcode_t::e_sub_constant:
+                    lanes_t::splat(constant, uint8_t(i.c));
+                    lanes_t::sub(value, b, constant);
+                    break;
+                case opcode_t::e_sub_from_constant:
+                    lanes_t::splat(constant, uint8_t(i.c));
+                    lanes_t::sub(value, constant, b);
+                    break;
+                case opcode_t::e_equal:
+                    lanes_t::equal(value, b, c);
+                    break;
+                case opcode_t::e_equal_constant:
+                    lanes_t::splat(constant, uint8_t(i.c));
+                    lanes_t::equal(value, b, constant);
+                    break;
+                case opcode_t::e_jump_if_zero: {
+                    if (_ends.size() <= depth) {
+                        _ends.resize(depth + 1);
+                        _masks.resize((depth + 2) * width);
+                    }
+                    uint8_t *mask = _masks.data() + size_t(depth) * width;
+                    lanes::test_t test = lanes_t::nonzero(mask + width, a, mask);
+                    if (test == lanes::test_t::e_none) pc = i.b;
+                    if (test == lanes::test_t::e_some) _ends[depth++] = i.b;
+                    continue;
+                }
+                case opcode_t::e_halt:
+                    return;
+            }
+            // temporaries are only read by the instructions of the same expression, the lanes that did not run
+            // those never look at them, a variable keeps its value in the lanes that did not run the instruction
+            if (depth && i.a < variables) {
+                lanes_t::blend(a, value, _masks.data() + size_t(depth) * width);
+            } else {
+                std::copy(value, value + width, a);
+            }
+        }
+    }
+
+private:
+    const bytecode_t& _bytecode;  // must outlive this
+    scan::level_t _level;
+    std::vector<uint8_t> _registers;  // by register, a byte for each lane of the group
+    std::vector<uint32_t> _ends;       // of the ifs whose bodies run with fewer lanes, by depth
+    std::vector<uint8_t> _masks;       // width bytes by depth, the lanes that run at it
+};
+
+#ifdef SL_AVX2
+#undef SL_AVX2
+#endif
+
+} // namespace sl
+
+#endif
@@ -0,0 +1,415 @@
+#ifndef BATCH_IO_HPP
+#define BATCH_IO_HPP
+
+// file reads and writes for the batch driver, submitted as io_uring batches when the kernel allows it
+// so that the cpu bound compiles overlap with the io, with blocking calls as the portable fallback
+
+#include "utility.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <deque>
+#include <initializer_list>
+#include <memory>
+#include <string>
+#include <system_error>
+#include <vector>
+
+#if defined(__linux__) && __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#include <sys/syscall.h>
+#define SL_HAS_IO_URING 1
+#endif
+
+namespace sl {
+
+struct io_result_t {
+    size_t index;      // as given to read or write
+    bool write;
+    int error;         // errno, 0 on success
+    std::string data;  // the contents of the file for reads
+};
+
+#ifdef SL_HAS_IO_URING
+
+// the raw rings, set up with the syscalls directly so there is no liburing dependency
+class io_uring_t {
+public:
+    // throws when the kernel has no io_uring (or it is blocked) or lacks one of the operations batch_io_t uses
+    explicit io_uring_t(unsigned entries) {
+        io_uring_params params{};
+        _fd = ::syscall(__NR_io_uring_setup, entries, &params);
+        if (_fd < 0) throw std::runtime_error("io_uring_setup failed");
+
+        _sq_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+        _cq_size = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+        bool single_mmap = params.features & IORING_FEAT_SINGLE_MMAP;
+        if (single_mmap) _sq_size = _cq_size = std::max(_sq_size, _cq_size);
+
+        _sq = ::mmap(nullptr, _sq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, _fd, IORING_OFF_SQ_RING);
+        _cq = single_mmap ? _sq : ::mmap(nullptr, _cq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, _fd, IORING_OFF_CQ_RING);
+        _sqes_size = params.sq_entries * sizeof(io_uring_sqe);
+        void *sqes = ::mmap(nullptr, _sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, _fd, IORING_OFF_SQES);
+        if (_sq == MAP_FAILED || _cq == MAP_FAILED || sqes == MAP_FAILED) {
+            if (sqes != MAP_FAILED) ::munmap(sqes, _sqes_size);
+            release();
+            throw std::runtime_error("io_uring mmap failed");
+        }
+        _sqes = static_cast<io_uring_sqe *>(sqes);
+
+        char *sq = static_cast<char *>(_sq);
+        _sq_head = reinterpret_cast<unsigned *>(sq + params.sq_off.head);
+        _sq_tail = reinterpret_cast<unsigned *>(sq + params.sq_off.tail);
+        _sq_mask = *reinterpret_cast<unsigned *>(sq + params.sq_off.ring_mask);
+        _sq_array = reinterpret_cast<unsigned *>(sq + params.sq_off.array);
+        _sq_entries = params.sq_entries;
+
+        char *cq = static_cast<char *>(_cq);
+        _cq_head = reinterpret_cast<unsigned *>(cq + params.cq_off.head);
+        _cq_tail = reinterpret_cast<unsigned *>(cq + params.cq_off.tail);
+        _cq_mask = *reinterpret_cast<unsigned *>(cq + params.cq_off.ring_mask);
+        _cqes = reinterpret_cast<io_uring_cqe *>(cq + params.cq_off.cqes);
+
+        if (!supports({ IORING_OP_OPENAT, IORING_OP_STATX, IORING_OP_READ, IORING_OP_WRITE, IORING_OP_CLOSE })) {
+            release();
+            throw std::runtime_error("io_uring lacks the needed operations");
+        }
+    }
+
+    io_uring_t(const io_uring_t&) = delete;
+    io_uring_t& operator=(const io_uring_t&) = delete;
+
+    ~io_uring_t() {
+        release();
+    }
+
+    unsigned entries() const {
+        return _sq_entries;
+    }
+
+    // a cleared entry at the tail of the submission queue, nullptr when it is full
+    io_uring_sqe *next_sqe() {
+        unsigned head = __atomic_load_n(_sq_head, __ATOMIC_ACQUIRE);
+        if (_sq_local_tail - head >= _sq_entries) return nullptr;
+        unsigned index = _sq_local_tail++ & _sq_mask;
+        io_uring_sqe *sqe = &_sqes[index];
+        std::memset(sqe, 0, sizeof(*sqe));
+        _sq_array[index] = index;
+        return sqe;
+    }
+
+    // submits the queued entries and waits until at least wait_for completions are available
+    void submit(unsigned wait_for) {
+        unsigned to_submit = _sq_local_tail - *_sq_tail;
+        __atomic_store_n(_sq_tail, _sq_local_tail, __ATOMIC_RELEASE);
+        while (true) {
+            long result = ::syscall(__NR_io_uring_enter, _fd, to_submit, wait_for, wait_for ? IORING_ENTER_GETEVENTS : 0, nullptr, 0);
+            if (result >= 0) return;
+            if (errno != EINTR) throw std::runtime_error("io_uring_enter failed");
+            to_submit = 0;
+        }
+    }
+
+    template <typename function_t>
+    void for_each_completion(function_t&& function) {
+        unsigned head = *_cq_head;
+        unsigned tail = __atomic_load_n(_cq_tail, __ATOMIC_ACQUIRE);
+        for (; head != tail; head++) {
+            function(_cqes[head & _cq_mask]);
+        }
+        __atomic_store_n(_cq_head, head, __ATOMIC_RELEASE);
+    }
+
+private:
+    bool supports(std::initializer_list<int> ops) {
+        constexpr unsigned op_count = 256;
+        std::vector<char> buffer(sizeof(io_uring_probe) + op_count * sizeof(io_uring_probe_op));
+        io_uring_probe *probe = reinterpret_cast<io_uring_probe *>(buffer.data());
+        if (::syscall(__NR_io_uring_register, _fd, IORING_REGISTER_PROBE, probe, op_count) < 0) return false;
+        for (int op : ops) {
+            if (op > probe->last_op || !(probe->ops[op].flags & IO_URING_OP_SUPPORTED)) return false;
+        }
+        return true;
+    }
+
+    void release() {
+        if (_sqes) ::munmap(_sqes, _sqes_size);
+        if (_cq && _cq != MAP_FAILED && _cq != _sq) ::munmap(_cq, _cq_size);
+        if (_sq && _sq != MAP_FAILED) ::munmap(_sq, _sq_size);
+        if (_fd >= 0) ::close(_fd);
+        _sqes = nullptr;
+        _sq = _cq = nullptr;
+        _fd = -1;
+    }
+
+private:
+    int _fd{ -1 };
+    void *_sq{ nullptr };
+    void *_cq{ nullptr };
+    size_t _sq_size{ 0 };
+    size_t _cq_size{ 0 };
+    size_t _sqes_size{ 0 };
+
+    io_uring_sqe *_sqes{ nullptr };
+    unsigned *_sq_head{ nullptr };
+    unsigned *_sq_tail{ nullptr };
+    unsigned *_sq_array{ nullptr };
+    unsigned _sq_mask{ 0 };
+    unsigned _sq_entries{ 0 };
+    unsigned _sq_local_tail{ 0 };
+
+    io_uring_cqe *_cqes{ nullptr };
+    unsigned *_cq_head{ nullptr };
+    unsigned *_cq_tail{ nullptr };
+    unsigned _cq_mask{ 0 };
+};
+
+#endif
+
+// queue reads and writes of whole files, then collect the finished ones with wait
+// with io_uring a read is an openat and a statx, then reads until the file is in, then a close,
+// a write is an openat, writes and a close, up to half the ring's entries of them are in flight at once
+// without it (or for stdin) each request is done on the spot with blocking calls
+class batch_io_t {
+public:
+    explicit batch_io_t(bool use_io_uring = true, unsigned entries = 64) {
+#ifdef SL_HAS_IO_URING
+        if (use_io_uring) {
+            try {
+                _ring = std::make_unique<io_uring_t>(entries);
+            } catch (const std::runtime_error&) {
+                _ring = nullptr;
+            }
+        }
+#endif
+    }
+
+    bool uses_io_uring() const {
+#ifdef SL_HAS_IO_URING
+        return _ring != nullptr;
+#else
+        return false;
+#endif
+    }
+
+    void read(size_t index, std::string path) {
+#ifdef SL_HAS_IO_URING
+        if (_ring && path != "-") {
+            start(request_t{ index, false, std::move(path), {} });
+            return;
+        }
+#endif
+        io_result_t result{ index, false, 0, {} };
+        try {
+            source_t source{ path };
+            result.data.assign(source.view());
+        } catch (const std::system_error& error) {
+            result.error = error.code().value();
+        } catch (const std::runtime_error&) {
+            result.error = EIO;
+        }
+        _done.push_back(std::move(result));
+    }
+
+    void write(size_t index, std::string path, std::string data) {
+#ifdef SL_HAS_IO_URING
+        if (_ring) {
+            start(request_t{ index, true, std::move(path), std::move(data) });
+            return;
+        }
+#endif
+        std::ofstream output{ path, std::ios::binary };
+        output << data;
+        _done.push_back({ index, true, output ? 0 : EIO, {} });
+    }
+
+    // requests queued or in flight that wait has not returned yet
+    size_t pending() const {
+        return _pending + _done.size();
+    }
+
+    // the requests that finished, blocks until there is at least one unless nothing is pending
+    std::vector<io_result_t> wait() {
+#ifdef SL_HAS_IO_URING
+        while (_ring && _done.empty() && _pending) {
+            _ring->submit(1);
+            _ring->for_each_completion([this](const io_uring_cqe& cqe) { complete(cqe); });
+        }
+#endif
+        std::vector<io_result_t> done;
+        done.swap(_done);
+        return done;
+    }
+
+private:
+#ifdef SL_HAS_IO_URING
+    enum op_t : uint8_t {
+        e_open,
+        e_statx,
+        e_read,
+        e_write,
+        e_close,
+    };
+
+    struct request_t {
+        size_t index;
+        bool write;
+        std::string path;
+        std::string data;
+        int fd{ -1 };
+        int error{ 0 };
+        size_t done{ 0 };           // bytes read or written so far
+        unsigned waiting{ 0 };      // operations in flight
+        bool regular{ true };       // size is known up front
+        struct statx stat{};
+    };
+
+    static uint64_t user_data(size_t slot, op_t op) {
+        return uint64_t(slot) << 8 | op;
+    }
+
+    void start(request_t request) {
+        _pending++;
+        _queued.push_back(std::move(request));
+        start_queued();
+    }
+
+    // moves queued requests into free slots while the ring has room for their first two operations
+    void start_queued() {
+        while (!_queued.empty() && _in_flight < _ring->entries() / 2) {
+            size_t slot;
+            if (_free.empty()) {
+                slot = _requests.size();
+                _requests.push_back(nullptr);
+            } else {
+                slot = _free.back();
+                _free.pop_back();
+            }
+            _requests[slot] = std::make_unique<request_t>(std::move(_queued.front()));
+            _queued.pop_front();
+            _in_flight++;
+
+            request_t& request = *_requests[slot];
+            io_uring_sqe *open = _ring->next_sqe();
+            open->opcode = IORING_OP_OPENAT;
+            open->fd = AT_FDCWD;
+            open->addr = reinterpret_cast<uint64_t>(request.path.c_str());
+            open->open_flags = request.write ? O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC : O_RDONLY | O_CLOEXEC;
+            open->len = request.write ? 0644 : 0;
+            open->user_data = user_data(slot, e_open);
+            request.waiting++;
+
+            if (!request.write) {
+                io_uring_sqe *stat = _ring->next_sqe();
+                stat->opcode = IORING_OP_STATX;
+                stat->fd = AT_FDCWD;
+                stat->addr = reinterpret_cast<uint64_t>(request.path.c_str());
+                stat->len = STATX_TYPE | STATX_SIZE;
+                stat->off = reinterpret_cast<uint64_t>(&request.stat);
+                stat->user_data = user_data(slot, e_statx);
+                request.waiting++;
+            }
+        }
+    }
+
+    void transfer(size_t slot) {
+        request_t& request = *_requests[slot];
+        io_uring_sqe *sqe = _ring->next_sqe();
+        sqe->opcode = request.write ? IORING_OP_WRITE : IORING_OP_READ;
+        sqe->fd = request.fd;
+        sqe->addr = reinterpret_cast<uint64_t>(request.data.data() + request.done);
+        sqe->len = std::min<size_t>(request.data.size() - request.done, 1u << 30);
+        sqe->off = request.done;
+        sqe->user_data = user_data(slot, request.write ? e_write : e_read);
+        request.waiting++;
+    }
+
+    void close(size_t slot) {
+        request_t& request = *_requests[slot];
+        io_uring_sqe *sqe = _ring->next_sqe();
+        sqe->opcode = IORING_OP_CLOSE;
+        sqe->fd = request.fd;
+        sqe->user_data = user_data(slot, e_close);
+        request.fd = -1;
+        request.waiting++;
+    }
+
+    // the request is done once nothing is in flight for it and its file is closed
+    void finish_if_idle(size_t slot) {
+        request_t& request = *_requests[slot];
+        if (request.waiting) return;
+        if (request.fd >= 0) {
+            close(slot);
+            return;
+        }
+        if (!request.write && !request.error) request.data.resize(request.done);
+        _done.push_back({ request.index, request.write, request.error, request.write ? std::string{} : std::move(request.data) });
+        _requests[slot] = nullptr;
+        _free.push_back(slot);
+        _in_flight--;
+        _pending--;
+        start_queued();
+    }
+
+    void complete(const io_uring_cqe& cqe) {
+        size_t slot = cqe.user_data >> 8;
+        op_t op = op_t(cqe.user_data & 0xff);
+        request_t& request = *_requests[slot];
+        request.waiting--;
+
+        if (cqe.res < 0 && op != e_close) {
+            request.error = request.error ? request.error : -cqe.res;
+            finish_if_idle(slot);
+            return;
+        }
+
+        switch (op) {
+            case e_open:
+                request.fd = cqe.res;
+                break;
+            case e_statx:
+                request.regular = S_ISREG(request.stat.stx_mode);
+                request.data.resize(request.regular ? request.stat.stx_size : 64 * 1024);
+                break;
+            case e_read:
+                request.done += cqe.res;
+                if (cqe.res == 0) {
+                    request.regular = true;  // end of file
+                    request.data.resize(request.done);
+                } else if (request.done == request.data.size() && !request.regular) {
+                    request.data.resize(request.data.size() * 2);
+                }
+                break;
+            case e_write:
+                request.done += cqe.res;
+                break;
+            case e_close:
+                break;
+        }
+
+        // both the open and the statx of a read are back, or a transfer was short
+        bool opened = request.fd >= 0 && request.waiting == 0 && !request.error;
+        if (opened && (op == e_open || op == e_statx || op == e_read || op == e_write)) {
+            if (request.done < request.data.size() || (!request.write && !request.regular)) {
+                transfer(slot);
+                return;
+            }
+        }
+        finish_if_idle(slot);
+    }
+
+    std::unique_ptr<io_uring_t> _ring;
+    std::vector<std::unique_ptr<request_t>> _requests;  // by slot, nullptr when free
+    std::vector<size_t> _free;
+    std::deque<request_t> _queued;
+    unsigned _in_flight{ 0 };
+#endif
+
+    size_t _pending{ 0 };  // started or queued, not yet in _done
+    std::vector<io_result_t> _done;
+};
+
+} // namespace sl
+
+#endif
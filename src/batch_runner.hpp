@@ -0,0 +1,177 @@
+#ifndef BATCH_RUNNER_HPP
+#define BATCH_RUNNER_HPP
+
+// runs large batches of (program, initial state) jobs on a thread pool and gives the final states back in the order
+// of the jobs as they are done
+// a program is parsed and turned into bytecode once, after that it is only read so every worker shares it; the jobs
+// are cut into chunks of consecutive jobs, a worker runs the jobs of a chunk that have the same program together
+// through batch_interpreter_t with interpreters kept in a scratch of its own from one chunk to the next
+
+#include "batch_interpreter.hpp"
+#include "bytecode.hpp"
+#include "lexer.hpp"
+#include "parser.hpp"
+#include "result.hpp"
+#include "thread_pool.hpp"
+
+#include <deque>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace sl {
+
+// read only once made, the states of its runs hold a byte for each variable by symbol id
+struct program_t {
+    program_t(ast_t ast, symbol_table_t symbols)
+      : ast(std::move(ast)), symbols(std::move(symbols)), bytecode(bytecode_gen_t{ this->ast, this->symbols }.gen()) {}
+
+    uint32_t variables() const {
+        return bytecode.variables;
+    }
+
+    ast_t ast;
+    symbol_table_t symbols;
+    bytecode_t bytecode;
+};
+
+// the program of source, or line:column: message
+inline Result<program_t, std::string> load_program(std::string_view source) {
+    try {
+        lexer_t lexer{ source };
+        token_buffer_t tokens = lexer.tokens();
+        parser_t parser{ tokens, source };
+        Result<std::pair<ast_t, symbol_table_t>, error_t> result = parser.parse();
+        if (!result) return Err(result.unwrapErr().message(source));
+        auto [ast, symbols] = result.take();
+        return Ok(program_t{ std::move(ast), std::move(symbols) });
+    } catch (const std::runtime_error& error) {
+        return Err(std::string(error.what()));
+    }
+}
+
+struct run_job_t {
+    const program_t *program;
+    const uint8_t *initial;  // program->variables() bytes, read while the job runs
+};
+
+class batch_runner_t {
+public:
+    explicit batch_runner_t(thread_pool_t& pool, size_t chunk_jobs = 256) : _pool(pool), _chunk_jobs(std::max<size_t>(chunk_jobs, 1)) {}
+
+    // calls done(index, final) from the calling thread for every job in order, final holds the variables() bytes of
+    // the job's program until done returns; the jobs, their programs and states must stay valid until run returns,
+    // which must not be called from a job of the pool as it waits for them
+    template <typename done_t>
+    void run(const run_job_t *jobs, size_t count, done_t done) {
+        size_t chunks = (count + _chunk_jobs - 1) / _chunk_jobs;
+        // a few chunks for each worker in flight keeps them busy without holding the states of the whole batch
+        size_t window = _pool.size() * 4;
+        std::deque<std::future<std::vector<uint8_t>>> running;
+        size_t next = 0;
+        try {
+            for (size_t chunk = 0; chunk < chunks; chunk++) {
+                for (; next < chunks && next < chunk + window; next++) {
+                    size_t begin = next * _chunk_jobs;
+                    size_t end = std::min(count, begin + _chunk_jobs);
+                    running.push_back(_pool.submit([this, jobs, begin, end] { return run_chunk(jobs + begin, end - begin); }));
+                }
+                std::vector<uint8_t> finals = running.front().get();
+                running.pop_front();
+                const uint8_t *final = finals.data();
+                for (size_t index = chunk * _chunk_jobs; index < std::min(count, (chunk + 1) * _chunk_jobs); index++) {
+                    done(index, final);
+                    final += jobs[index].program->variables();
+                }
+            }
+        } catch (...) {
+            // the chunks still running read the jobs
+            for (std::future<std::vector<uint8_t>>& chunk : running) chunk.wait();
+            throw;
+        }
+        // the interpreters of the scratches refer to the programs, which may be gone after this
+        std::lock_guard lock{ _scratch_mutex };
+        _scratches.clear();
+    }
+
+    void run(const std::vector<run_job_t>& jobs, std::vector<uint8_t>& finals) {
+        size_t size = 0;
+        for (const run_job_t& job : jobs) size += job.program->variables();
+        finals.resize(size);
+        uint8_t *out = finals.data();
+        run(jobs.data(), jobs.size(), [&](size_t index, const uint8_t *final) {
+            out = std::copy(final, final + jobs[index].program->variables(), out);
+        });
+    }
+
+private:
+    // batch interpreters for the program a worker ran last, one with vector lanes and one for runs shorter than those
+    struct scratch_t {
+        const bytecode_t *bytecode{ nullptr };
+        std::optional<batch_interpreter_t> lanes;
+        std::optional<batch_interpreter_t> single;
+
+        batch_interpreter_t& interpreter(const bytecode_t& program, size_t states) {
+            if (bytecode != &program) {
+                bytecode = &program;
+                lanes.emplace(program);
+                single.emplace(program, scan::level_t::e_scalar);
+            }
+            // a group of vector lanes costs about as much as three states run one at a time
+            return states < 4 ? *single : *lanes;
+        }
+    };
+
+    // the final states of the jobs one after the other
+    std::vector<uint8_t> run_chunk(const run_job_t *jobs, size_t count) {
+        size_t size = 0;
+        for (size_t i = 0; i < count; i++) size += jobs[i].program->variables();
+        std::vector<uint8_t> finals(size);
+
+        std::unique_ptr<scratch_t> scratch = take_scratch();
+        uint8_t *states = finals.data();
+        for (size_t begin = 0; begin < count;) {
+            const program_t& program = *jobs[begin].program;
+            size_t end = begin + 1;
+            while (end < count && jobs[end].program == &program) end++;
+            // the initial states are gathered where their final states go and run in place
+            uint32_t variables = program.variables();
+            for (size_t i = begin; i < end; i++) std::copy(jobs[i].initial, jobs[i].initial + variables, states + (i - begin) * variables);
+            scratch->interpreter(program.bytecode, end - begin).run(states, states, end - begin);
+            states += (end - begin) * variables;
+            begin = end;
+        }
+        give_scratch(std::move(scratch));
+        return finals;
+    }
+
+    // no more are made than jobs run at the same time, one for each worker
+    std::unique_ptr<scratch_t> take_scratch() {
+        std::lock_guard lock{ _scratch_mutex };
+        if (_scratches.empty()) return std::make_unique<scratch_t>();
+        std::unique_ptr<scratch_t> scratch = std::move(_scratches.back());
+        _scratches.pop_back();
+        return scratch;
+    }
+
+    void give_scratch(std::unique_ptr<scratch_t> scratch) {
+        std::lock_guard lock{ _scratch_mutex };
+        _scratches.push_back(std::move(scratch));
+    }
+
+private:
+    thread_pool_t& _pool;
+    size_t _chunk_jobs;
+
+    std::mutex _scratch_mutex;
+    std::vector<std::unique_ptr<scratch_t>> _scratches;  // of the workers that are not running a chunk
+};
+
+} // namespace sl
+
+#endif
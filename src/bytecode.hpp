@@ -0,0 +1,332 @@
+#ifndef BYTECODE_HPP
+#define BYTECODE_HPP
+
+// a register bytecode for running programs faster than interpreter_t walks the ast
+// every variable is a register and the registers after them hold the temporaries of expressions, numbers are
+// folded into the instructions that use them and an if is a conditional jump past its body
+// which variables a run touched is not tracked while running: the code is split into blocks at the ifs, the
+// jumps that were taken are recorded, and get_state follows them through the blocks to collect the variables
+
+#include "interpreter.hpp"
+#include "parser.hpp"
+
+#include <string>
+#include <vector>
+
+namespace sl {
+
+enum class opcode_t : uint8_t {
+    e_load,                // r[a] = b
+    e_move,                // r[a] = r[b]
+    e_add,                 // r[a] = r[b] + r[c]
+    e_add_constant,        // r[a] = r[b] + c
+    e_sub,                 // r[a] = r[b] - r[c]
+    e_sub_constant,        // r[a] = r[b] - c
+    e_sub_from_constant,   // r[a] = c - r[b]
+    e_equal,               // r[a] = r[b] == r[c]
+    e_equal_constant,      // r[a] = r[b] == c
+    e_jump_if_zero,        // if r[a] == 0, jump c is taken and the code goes on at b
+    e_halt,
+};
+
+struct instruction_t {
+    opcode_t op;
+    uint32_t a;
+    uint32_t b;
+    uint32_t c;
+};
+
+// the code of a program, read only once generated so any number of vms may run it at the same time
+struct bytecode_t {
+    static constexpr uint32_t npos = ~0u;
+
+    // straight line code between ifs, the variables its statements name are touched[touched_begin, touched_end)
+    struct block_t {
+        uint32_t touched_begin;
+        uint32_t touched_end;
+        uint32_t jump;    // of the if ending the block, npos when it runs into the next block
+        uint32_t target;  // the block after the body of that if
+    };
+
+    std::vector<instruction_t> code;
+    std::vector<block_t> blocks;
+    std::vector<uint32_t> touched;
+    uint32_t variables{ 0 };  // registers [0, variables) are the variables by symbol id
+    uint32_t registers{ 0 };  // with the temporaries
+    uint32_t jumps{ 0 };
+};
+
+class bytecode_gen_t {
+public:
+    bytecode_gen_t(ast_view_t ast, names_view_t symbols) : _ast(ast), _touched_in(symbols.size(), 0), _effects(ast.expressions.size()) {
+        _bytecode.variables = symbols.size();
+        _bytecode.registers = symbols.size();
+        _bytecode.code.reserve(ast.statements.size() + ast.expressions.size() / 2);
+        // children come before their parents, so one pass finds the expressions that assign somewhere inside
+        for (uint32_t i = 0; i < ast.expressions.size(); i++) {
+            const expression_t& expression = ast.expressions[i];
+            if (expression.type != expression_type_t::e_binary) continue;
+            _effects[i] = expression.op == op_t::e_assign || _effects[expression.as.binary.left] || _effects[expression.as.binary.right];
+        }
+    }
+
+    bytecode_t gen() {
+        gen_block(0, _ast.statements.size());
+        end_block(bytecode_t::npos);
+        emit(opcode_t::e_halt, 0, 0, 0);
+        return std::move(_bytecode);
+    }
+
+private:
+    // a register or, for numbers, the value itself
+    struct operand_t {
+        bool constant;
+        uint32_t value;
+    };
+
+    static constexpr uint32_t no_target = ~0u;
+
+    void gen_block(uint32_t begin, uint32_t end) {
+        for (uint32_t index = begin; index < end; index = _ast.next(index)) {
+            const statement_t& statement = _ast.statements[index];
+            switch (statement.type) {
+                case statement_type_t::e_declaration:
+                    gen_declaration(statement);
+                    break;
+                case statement_type_t::e_expression:
+                    // without an assignment only the variables it reads matter, for get_state
+                    if (_effects[statement.expression]) {
+                        gen_expression(statement.expression, 0, no_target);
+                    } else {
+                        touch_all(statement.expression);
+                    }
+                    break;
+                case statement_type_t::e_if:
+                    gen_if(index);
+                    break;
+            }
+        }
+    }
+
+    void gen_declaration(const statement_t& declaration) {
+        touch(declaration.id);
+        // a variable is declared once and its register starts at 0, or at the value batch_interpreter_t is given
+        if (declaration.expression == ast_t::npos) return;
+        store(declaration.id, gen_expression(declaration.expression, 0, declaration.id));
+    }
+
+    void gen_if(uint32_t index) {
+        const statement_t& _if = _ast.statements[index];
+        operand_t condition = gen_expression(_if.expression, 0, no_target);
+        if (condition.constant) {
+            store(temporary(0), condition);
+            condition = { false, temporary(0) };
+        }
+        uint32_t jump = _bytecode.jumps++;
+        uint32_t instruction = emit(opcode_t::e_jump_if_zero, condition.value, 0, jump);
+        uint32_t block = end_block(jump);
+        gen_block(index + 1, _if.end);
+        end_block(bytecode_t::npos);
+        _bytecode.code[instruction].b = _bytecode.code.size();
+        _bytecode.blocks[block].target = _bytecode.blocks.size();
+    }
+
+    // the value of expression as an operand, in target when it is computed by an instruction and target is given
+    // the right side is evaluated before the left one like interpreter_t does, a variable read on the right is
+    // copied first when the left side assigns, as the register would otherwise be read after the assignment
+    operand_t gen_expression(uint32_t index, uint32_t depth, uint32_t target) {
+        const expression_t& expression = _ast.expressions[index];
+        switch (expression.type) {
+            case expression_type_t::e_number:
+                return { true, uint8_t(expression.as.number) };
+            case expression_type_t::e_identifier:
+                touch(expression.as.id);
+                return { false, expression.as.id };
+            case expression_type_t::e_binary:
+                break;
+        }
+
+        if (expression.op == op_t::e_assign) {
+            uint32_t id = _ast.expressions[expression.as.binary.left].as.id;
+            touch(id);
+            store(id, gen_expression(expression.as.binary.right, depth, id));
+            return { false, id };
+        }
+
+        operand_t right = gen_expression(expression.as.binary.right, depth, no_target);
+        uint32_t left_depth = depth;
+        if (!right.constant && right.value >= _bytecode.variables) {
+            left_depth++;
+        } else if (!right.constant && _effects[expression.as.binary.left]) {
+            emit(opcode_t::e_move, temporary(depth), right.value, 0);
+            right = { false, temporary(depth) };
+            left_depth++;
+        }
+        operand_t left = gen_expression(expression.as.binary.left, left_depth, no_target);
+
+        if (left.constant && right.constant) return { true, fold(expression.op, left.value, right.value) };
+        uint32_t result = target == no_target ? temporary(depth) : target;
+        switch (expression.op) {
+            case op_t::e_plus:
+                if (left.constant) std::swap(left, right);
+                emit(right.constant ? opcode_t::e_add_constant : opcode_t::e_add, result, left.value, right.value);
+                break;
+            case op_t::e_equal:
+                if (left.constant) std::swap(left, right);
+                emit(right.constant ? opcode_t::e_equal_constant : opcode_t::e_equal, result, left.value, right.value);
+                break;
+            case op_t::e_minus:
+                if (left.constant) {
+                    emit(opcode_t::e_sub_from_constant, result, right.value, left.value);
+                } else {
+                    emit(right.constant ? opcode_t::e_sub_constant : opcode_t::e_sub, result, left.value, right.value);
+                }
+                break;
+            default:
+                break;
+        }
+        return { false, result };
+    }
+
+    static uint32_t fold(op_t op, uint32_t left, uint32_t right) {
+        switch (op) {
+            case op_t::e_plus:
+                return uint8_t(left + right);
+            case op_t::e_minus:
+                return uint8_t(left - right);
+            case op_t::e_equal:
+                return left == right;
+            default:
+                return 0;
+        }
+    }
+
+    void store(uint32_t destination, operand_t value) {
+        if (value.constant) {
+            emit(opcode_t::e_load, destination, value.value, 0);
+        } else if (value.value != destination) {
+            emit(opcode_t::e_move, destination, value.value, 0);
+        }
+    }
+
+    uint32_t temporary(uint32_t depth) {
+        uint32_t index = _bytecode.variables + depth;
+        _bytecode.registers = std::max(_bytecode.registers, index + 1);
+        return index;
+    }
+
+    uint32_t emit(opcode_t op, uint32_t a, uint32_t b, uint32_t c) {
+        _bytecode.code.push_back({ op, a, b, c });
+        return _bytecode.code.size() - 1;
+    }
+
+    // the variable is named by a statement of the current block, recorded once per block
+    void touch(uint32_t id) {
+        uint32_t block = _bytecode.blocks.size() + 1;
+        if (_touched_in[id] == block) return;
+        _touched_in[id] = block;
+        _bytecode.touched.push_back(id);
+    }
+
+    void touch_all(uint32_t index) {
+        const expression_t& expression = _ast.expressions[index];
+        if (expression.type == expression_type_t::e_identifier) touch(expression.as.id);
+        if (expression.type != expression_type_t::e_binary) return;
+        touch_all(expression.as.binary.right);
+        touch_all(expression.as.binary.left);
+    }
+
+    uint32_t end_block(uint32_t jump) {
+        uint32_t begin = _bytecode.blocks.empty() ? 0 : _bytecode.blocks.back().touched_end;
+        _bytecode.blocks.push_back({ begin, uint32_t(_bytecode.touched.size()), jump, bytecode_t::npos });
+        return _bytecode.blocks.size() - 1;
+    }
+
+private:
+    ast_view_t _ast;  // the ast it views must outlive this
+    bytecode_t _bytecode;
+    std::vector<uint32_t> _touched_in;  // by symbol id, 1 + the block that last recorded it
+    std::vector<uint8_t> _effects;       // by expression, whether it assigns
+};
+
+// the state of a run of bytecode, from its registers and which of its jumps were taken
+inline std::string bytecode_state(const bytecode_t& bytecode, names_view_t symbols, const uint8_t *registers, const uint8_t *taken) {
+    std::vector<bool> live(bytecode.variables);
+    for (uint32_t block = 0; block < bytecode.blocks.size();) {
+        const bytecode_t::block_t& current = bytecode.blocks[block];
+        for (uint32_t i = current.touched_begin; i < current.touched_end; i++) live[bytecode.touched[i]] = true;
+        block = current.jump != bytecode_t::npos && taken[current.jump] ? current.target : block + 1;
+    }
+    return format_state(symbols, registers, live);
+}
+
+// runs bytecode from the start to the end in one call, the registers start at 0 on every run
+class bytecode_vm_t {
+public:
+    bytecode_vm_t(const bytecode_t& bytecode, names_view_t symbols)
+      : _bytecode(bytecode), _symbols(symbols), _registers(bytecode.registers), _taken(bytecode.jumps) {}
+
+    void run() {
+        std::fill(_registers.begin(), _registers.end(), 0);
+        std::fill(_taken.begin(), _taken.end(), 0);
+        const instruction_t *code = _bytecode.code.data();
+        const instruction_t *pc = code;
+        uint8_t *r = _registers.data();
+        uint8_t *taken = _taken.data();
+        while (true) {
+            const instruction_t& i = *pc++;
+            switch (i.op) {
+                case opcode_t::e_load:
+                    r[i.a] = uint8_t(i.b);
+                    break;
+                case opcode_t::e_move:
+                    r[i.a] = r[i.b];
+                    break;
+                case opcode_t::e_add:
+                    r[i.a] = r[i.b] + r[i.c];
+                    break;
+                case opcode_t::e_add_constant:
+                    r[i.a] = r[i.b] + i.c;
+                    break;
+                case opcode_t::e_sub:
+                    r[i.a] = r[i.b] - r[i.c];
+                    break;
+                case opcode_t::e_sub_constant:
+                    r[i.a] = r[i.b] - i.c;
+                    break;
+                case opcode_t::e_sub_from_constant:
+                    r[i.a] = i.c - r[i.b];
+                    break;
+                case opcode_t::e_equal:
+                    r[i.a] = r[i.b] == r[i.c];
+                    break;
+                case opcode_t::e_equal_constant:
+                    r[i.a] = r[i.b] == i.c;
+                    break;
+                case opcode_t::e_jump_if_zero:
+                    if (!r[i.a]) {
+                        taken[i.c] = 1;
+                        pc = code + i.b;
+                    }
+                    break;
+                case opcode_t::e_halt:
+                    return;
+            }
+        }
+    }
+
+    // the state interpreter_t gives after running the same program
+    std::string get_state() const {
+        return bytecode_state(_bytecode, _symbols, _registers.data(), _taken.data());
+    }
+
+private:
+    const bytecode_t& _bytecode;  // must outlive this
+    names_view_t _symbols;
+    std::vector<uint8_t> _registers;
+    std::vector<uint8_t> _taken;  // by jump, whether the if it belongs to skipped its body
+};
+
+} // namespace sl
+
+#endif
@@ -0,0 +1,317 @@
+#ifndef CACHE_HPP
+#define CACHE_HPP
+
+// on disk cache of compiler outputs, an entry is named by a 128 bit hash of the source, the compiler version and
+// the options that change the output, so an unchanged source is answered without lexing or parsing it
+// entries are written to a temporary file and renamed into place, readers never see half an entry, and the
+// least recently used ones are removed once the cache grows past its size limit
+// processes may share a directory, each keeps its own index of it and tolerates entries the others removed
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <mutex>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <unordered_map>
+#include <vector>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <unistd.h>
+#endif
+
+namespace sl {
+
+struct cache_key_t {
+    uint64_t high{ 0 };
+    uint64_t low{ 0 };
+
+    bool operator==(const cache_key_t& other) const {
+        return high == other.high && low == other.low;
+    }
+
+    // 32 hex digits, the name of the entry
+    std::string hex() const {
+        static constexpr char digits[] = "0123456789abcdef";
+        std::string text(32, '0');
+        for (size_t i = 0; i < 16; i++) {
+            text[15 - i] = digits[(high >> (4 * i)) & 0xf];
+            text[31 - i] = digits[(low >> (4 * i)) & 0xf];
+        }
+        return text;
+    }
+
+    static std::optional<cache_key_t> from_hex(std::string_view text) {
+        if (text.size() != 32) return std::nullopt;
+        cache_key_t key;
+        for (size_t i = 0; i < 32; i++) {
+            char c = text[i];
+            uint64_t digit = c >= '0' && c <= '9' ? c - '0' : c >= 'a' && c <= 'f' ? c - 'a' + 10 : 16;
+            if (digit == 16) return std::nullopt;
+            uint64_t& half = i < 16 ? key.high : key.low;
+            half = half << 4 | digit;
+        }
+        return key;
+    }
+};
+
+// two independently seeded 64 bit lanes over the bytes, 8 at a time, not meant to withstand crafted collisions
+class hasher_t {
+public:
+    hasher_t& add(std::string_view bytes) {
+        size_t i = 0;
+        for (; i + 8 <= bytes.size(); i += 8) {
+            uint64_t word;
+            std::memcpy(&word, bytes.data() + i, 8);
+            mix(word);
+        }
+        if (i < bytes.size()) {
+            uint64_t word = 0;
+            std::memcpy(&word, bytes.data() + i, bytes.size() - i);
+            mix(word);
+        }
+        // the length keeps "ab" + "c" apart from "a" + "bc"
+        mix(bytes.size());
+        return *this;
+    }
+
+    hasher_t& add(uint64_t value) {
+        mix(value);
+        return *this;
+    }
+
+    cache_key_t key() const {
+        uint64_t high = finish(_high ^ rotl(_low, 29));
+        uint64_t low = finish(_low ^ rotl(_high, 41));
+        return { high, low };
+    }
+
+private:
+    static uint64_t rotl(uint64_t value, int bits) {
+        return value << bits | value >> (64 - bits);
+    }
+
+    static uint64_t finish(uint64_t value) {
+        value ^= value >> 33;
+        value *= 0xff51afd7ed558ccdull;
+        value ^= value >> 33;
+        value *= 0xc4ceb9fe1a85ec53ull;
+        value ^= value >> 33;
+        return value;
+    }
+
+    void mix(uint64_t word) {
+        _high = rotl(_high ^ word * 0x9e3779b97f4a7c15ull, 31) * 0x87c37b91114253d5ull;
+        _low = rotl(_low + word * 0xc2b2ae3d27d4eb4full, 27) * 0x4cf5ad432745937full + 0x52dce729;
+    }
+
+private:
+    uint64_t _high{ 0x243f6a8885a308d3ull };
+    uint64_t _low{ 0x13198a2e03707344ull };
+};
+
+struct cache_stats_t {
+    uint64_t hits{ 0 };
+    uint64_t misses{ 0 };
+    uint64_t stores{ 0 };
+    uint64_t evictions{ 0 };
+    uint64_t entries{ 0 };
+    uint64_t bytes{ 0 };  // of all entries
+};
+
+class cache_t {
+public:
+    // the directory is created if needed and its entries are indexed, throws when it cannot be created
+    explicit cache_t(std::filesystem::path directory, uint64_t max_bytes = 256ull << 20)
+        : _directory(std::move(directory)), _max_bytes(max_bytes) {
+        std::error_code error;
+        std::filesystem::create_directories(_directory, error);
+        if (error) throw std::runtime_error("failed to create " + _directory.string() + ": " + error.message());
+        scan();
+    }
+
+    cache_t(const cache_t&) = delete;
+    cache_t& operator=(const cache_t&) = delete;
+
+    // the output of a missed lookup may be stored under the same key
+    std::optional<std::string> lookup(const cache_key_t& key) {
+        std::optional<std::string> output = read(key);
+        if (output) {
+            // the modification time is the last use for the processes that index the directory after this one
+            std::error_code error;
+            std::filesystem::last_write_time(entry_path(key), std::filesystem::file_time_type::clock::now(), error);
+        }
+        std::lock_guard lock{ _mutex };
+        if (!output) {
+            _stats.misses++;
+            // gone from the disk, another process evicted it
+            if (auto it = _entries.find(key); it != _entries.end()) forget(it);
+            return std::nullopt;
+        }
+        _stats.hits++;
+        auto [it, inserted] = _entries.try_emplace(key, entry_t{ uint64_t(output->size()), 0 });
+        if (inserted) {
+            _stats.entries++;
+            _stats.bytes += it->second.size;
+        }
+        it->second.last_use = ++_clock;
+        return output;
+    }
+
+    // failing to write is not an error, the output is simply not cached
+    void store(const cache_key_t& key, std::string_view output) {
+        std::filesystem::path path = entry_path(key);
+        std::filesystem::path temporary = _directory / temporary_name();
+        {
+            std::ofstream file{ temporary, std::ios::binary };
+            file.write(magic, sizeof(magic) - 1);
+            file.write(output.data(), output.size());
+            if (!file.flush()) {
+                std::error_code error;
+                std::filesystem::remove(temporary, error);
+                return;
+            }
+        }
+        std::error_code error;
+        std::filesystem::rename(temporary, path, error);
+        if (error) {
+            std::filesystem::remove(temporary, error);
+            return;
+        }
+
+        std::lock_guard lock{ _mutex };
+        auto [it, inserted] = _entries.try_emplace(key, entry_t{ 0, 0 });
+        if (inserted) {
+            _stats.entries++;
+        } else {
+            _stats.bytes -= it->second.size;
+        }
+        it->second.size = output.size();
+        it->second.last_use = ++_clock;
+        _stats.bytes += output.size();
+        _stats.stores++;
+        evict();
+    }
+
+    cache_stats_t stats() const {
+        std::lock_guard lock{ _mutex };
+        return _stats;
+    }
+
+    const std::filesystem::path& directory() const {
+        return _directory;
+    }
+
+private:
+    struct entry_t {
+        uint64_t size;      // of the output
+        uint64_t last_use;  // of _clock
+    };
+
+    struct key_hash_t {
+        size_t operator()(const cache_key_t& key) const {
+            return size_t(key.high ^ key.low);
+        }
+    };
+
+    static constexpr char magic[] = "SLCACHE1\n";  // a file without it is not an entry, or one of an older layout
+    static constexpr std::string_view extension = ".out";
+
+    std::filesystem::path entry_path(const cache_key_t& key) const {
+        return _directory / (key.hex() + std::string(extension));
+    }
+
+    std::optional<std::string> read(const cache_key_t& key) const {
+        std::ifstream file{ entry_path(key), std::ios::binary | std::ios::ate };
+        if (!file) return std::nullopt;
+        std::streamoff size = file.tellg();
+        char header[sizeof(magic) - 1];
+        if (size < std::streamoff(sizeof(header)) || !file.seekg(0).read(header, sizeof(header))) return std::nullopt;
+        if (std::memcmp(header, magic, sizeof(header)) != 0) return std::nullopt;
+        std::string output(size - sizeof(header), '\0');
+        if (!file.read(output.data(), output.size())) return std::nullopt;
+        return output;
+    }
+
+    // unique within the directory across threads and processes that share it
+    std::string temporary_name() {
+#if defined(__unix__) || defined(__APPLE__)
+        uint64_t process = ::getpid();
+#else
+        uint64_t process = std::chrono::steady_clock::now().time_since_epoch().count();
+#endif
+        return "tmp-" + std::to_string(process) + "-" + std::to_string(_temporaries++);
+    }
+
+    // the entries already on disk, oldest modification first so that they are evicted first
+    void scan() {
+        std::vector<std::pair<std::filesystem::file_time_type, std::pair<cache_key_t, uint64_t>>> found;
+        std::error_code error;
+        for (const std::filesystem::directory_entry& file : std::filesystem::directory_iterator(_directory, error)) {
+            std::filesystem::path path = file.path();
+            if (path.extension() != extension) continue;
+            std::optional<cache_key_t> key = cache_key_t::from_hex(path.stem().string());
+            std::error_code file_error;
+            uint64_t size = file.file_size(file_error);
+            std::filesystem::file_time_type time = file.last_write_time(file_error);
+            if (!key || file_error || size < sizeof(magic) - 1) continue;
+            found.push_back({ time, { *key, size - (sizeof(magic) - 1) } });
+        }
+        std::sort(found.begin(), found.end(), [](const auto& a, const auto& b) { return a.first < b.first; });
+
+        std::lock_guard lock{ _mutex };
+        for (const auto& [time, entry] : found) {
+            _entries[entry.first] = { entry.second, ++_clock };
+            _stats.entries++;
+            _stats.bytes += entry.second;
+        }
+        evict();
+    }
+
+    void forget(std::unordered_map<cache_key_t, entry_t, key_hash_t>::iterator it) {
+        _stats.entries--;
+        _stats.bytes -= it->second.size;
+        _entries.erase(it);
+    }
+
+    // the least recently used entries go until the cache fits, the caller holds _mutex
+    void evict() {
+        if (_stats.bytes <= _max_bytes) return;
+        std::vector<std::pair<uint64_t, cache_key_t>> order;
+        order.reserve(_entries.size());
+        for (const auto& [key, entry] : _entries) {
+            order.push_back({ entry.last_use, key });
+        }
+        std::sort(order.begin(), order.end(), [](const auto& a, const auto& b) { return a.first < b.first; });
+        // down to 3/4 of the limit so that a full cache does not sort on every store
+        uint64_t target = _max_bytes - _max_bytes / 4;
+        for (const auto& [last_use, key] : order) {
+            if (_stats.bytes <= target) break;
+            std::error_code error;
+            std::filesystem::remove(entry_path(key), error);
+            forget(_entries.find(key));
+            _stats.evictions++;
+        }
+    }
+
+private:
+    std::filesystem::path _directory;
+    uint64_t _max_bytes;
+    std::atomic<uint64_t> _temporaries{ 0 };
+
+    mutable std::mutex _mutex;  // guards everything below
+    std::unordered_map<cache_key_t, entry_t, key_hash_t> _entries;
+    uint64_t _clock{ 0 };  // counts uses, orders the entries for eviction
+    cache_stats_t _stats;
+};
+
+} // namespace sl
+
+#endif
@@ -0,0 +1,159 @@
+#ifndef CLI_HPP
+#define CLI_HPP
+
+// the command line shared by simpleLang and the thin client in tools/, which takes the same options
+
+#include "compiler.hpp"
+
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <optional>
+#include <set>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+namespace sl {
+
+inline void usage(std::string_view program) {
+    std::cerr <<
+        "usage: " << program << " [options] {path to .sl src}...\n"
+        "  -o <dir>         write the output of every input to <dir>/<name>.asm\n"
+        "  -m <manifest>    also compile the paths listed in manifest, one per line, # starts a comment\n"
+        "  -j <n>           compile on n threads, defaults to the number of cores\n"
+        "  --run            output the variables after running the program instead of the asm\n"
+        "  --emit-ast       output the binary ast instead of the asm, inputs that are ast files are not parsed again\n"
+        "  --lexer=<name>   hand (default) or dfa\n"
+        "  --engine=<name>  tree (default), bytecode, closure or jit, what runs the program with --run\n"
+        "  --io=<name>      uring (default, where the kernel has it) or sync, how -o reads and writes the files\n"
+        "  --serve <socket> keep running and compile the requests sent to the unix socket, see tools/client.cpp\n"
+        "  --cache <dir>    reuse the outputs of sources compiled before with the same options\n"
+        "  --cache-size <n> evict the least recently used outputs past n MiB, defaults to 256\n"
+        "  --cache-stats    print the hits and misses of the cache when done\n"
+        "  --lsp            run as a language server on stdin and stdout, for editors to show errors as the code is typed\n"
+        "  --watch          keep running and compile the inputs again whenever they are saved, only what changed is redone\n"
+        "  --stream         lex and parse the input as it is read instead of loading it whole, for sources too large to hold\n"
+        "a single input without -o is written to stdout, - reads it from stdin\n";
+}
+
+struct cli_options_t {
+    std::vector<std::string> inputs;
+    std::optional<std::filesystem::path> output_dir;
+    size_t jobs{ std::thread::hardware_concurrency() };
+    bool io_uring{ true };
+    std::optional<std::string> serve;  // socket path of the compile server
+    std::optional<std::filesystem::path> cache_dir;
+    uint64_t cache_bytes{ 256ull << 20 };
+    bool cache_stats{ false };
+    bool watch{ false };
+    bool lsp{ false };
+    bool stream{ false };  // see compile_stream
+    compile_options_t compile;
+};
+
+inline std::optional<cli_options_t> parse_args(int argc, char **argv) {
+    cli_options_t options;
+    for (int i = 1; i < argc; i++) {
+        std::string_view arg = argv[i];
+        bool has_value = i + 1 < argc;
+        if (arg == "-o" && has_value) {
+            options.output_dir = argv[++i];
+        } else if (arg == "-m" && has_value) {
+            std::ifstream manifest{ argv[++i] };
+            if (!manifest) {
+                std::cerr << "failed to open " << argv[i] << '\n';
+                return std::nullopt;
+            }
+            for (std::string line; std::getline(manifest, line);) {
+                line = line.substr(0, line.find('#'));
+                line.erase(0, line.find_first_not_of(" \t\r"));
+                line.erase(line.find_last_not_of(" \t\r") + 1);
+                if (!line.empty()) options.inputs.push_back(line);
+            }
+        } else if (arg == "-j" && has_value) {
+            options.jobs = std::strtoul(argv[++i], nullptr, 10);
+        } else if (arg == "--run") {
+            options.compile.run = true;
+        } else if (arg == "--emit-ast") {
+            options.compile.emit_ast = true;
+        } else if (arg == "--lexer=hand") {
+            options.compile.engine = lexer_engine_t::e_hand_written;
+        } else if (arg == "--lexer=dfa") {
+            options.compile.engine = lexer_engine_t::e_dfa;
+        } else if (arg == "--engine=tree") {
+            options.compile.run_engine = run_engine_t::e_tree;
+        } else if (arg == "--engine=bytecode") {
+            options.compile.run_engine = run_engine_t::e_bytecode;
+        } else if (arg == "--engine=closure") {
+            options.compile.run_engine = run_engine_t::e_closure;
+        } else if (arg == "--engine=jit") {
+            options.compile.run_engine = run_engine_t::e_jit;
+        } else if (arg == "--io=uring") {
+            options.io_uring = true;
+        } else if (arg == "--io=sync") {
+            options.io_uring = false;
+        } else if (arg == "--serve" && has_value) {
+            options.serve = argv[++i];
+        } else if (arg == "--cache" && has_value) {
+            options.cache_dir = argv[++i];
+        } else if (arg == "--cache-size" && has_value) {
+            options.cache_bytes = std::strtoull(argv[++i], nullptr, 10) << 20;
+        } else if (arg == "--lsp") {
+            options.lsp = true;
+        } else if (arg == "--watch") {
+            options.watch = true;
+        } else if (arg == "--stream") {
+            options.stream = true;
+        } else if (arg == "--cache-stats") {
+            options.cache_stats = true;
+        } else if (arg == "-h" || arg == "--help") {
+            return std::nullopt;
+        } else if (arg.size() > 1 && arg[0] == '-') {
+            std::cerr << "unknown option " << arg << '\n';
+            return std::nullopt;
+        } else {
+            options.inputs.emplace_back(arg);
+        }
+    }
+    options.jobs = std::max<size_t>(options.jobs, 1);
+    if (options.serve || options.lsp) return options;
+    if (options.inputs.empty()) return std::nullopt;
+    if (options.watch && std::find(options.inputs.begin(), options.inputs.end(), "-") != options.inputs.end()) {
+        std::cerr << "--watch needs files, stdin cannot be watched\n";
+        return std::nullopt;
+    }
+    if (options.inputs.size() > 1 && !options.output_dir) {
+        std::cerr << "several inputs need -o <dir>\n";
+        return std::nullopt;
+    }
+    if (options.stream && (options.output_dir || options.watch || options.cache_dir)) {
+        std::cerr << "--stream compiles a single input to stdout, without -o, --watch or --cache\n";
+        return std::nullopt;
+    }
+    return options;
+}
+
+// <stem>.asm (.state with --run, .slast with --emit-ast), inputs with the same stem get -1, -2, ... in the order they were given, so names do not depend on timing
+// a suffix already taken by another input's name (x/a.sl y/a.sl a-1.sl) is skipped
+inline std::vector<std::filesystem::path> output_paths(const cli_options_t& options) {
+    std::vector<std::filesystem::path> paths;
+    std::set<std::string> seen;
+    std::map<std::string, size_t> suffixes;  // the last suffix given to each stem
+    const char *extension = options.compile.emit_ast ? ".slast" : options.compile.run ? ".state" : ".asm";
+    for (const std::string& input : options.inputs) {
+        std::string stem = input == "-" ? "stdin" : std::filesystem::path(input).stem().string();
+        std::string name = stem;
+        for (size_t& suffix = suffixes[stem]; seen.count(name);) name = stem + "-" + std::to_string(++suffix);
+        seen.insert(name);
+        paths.push_back(*options.output_dir / (name + extension));
+    }
+    return paths;
+}
+
+} // namespace sl
+
+#endif
@@ -0,0 +1,312 @@
+#ifndef CLOSURE_INTERPRETER_HPP
+#define CLOSURE_INTERPRETER_HPP
+
+// runs a program like interpreter_t but every statement and expression is turned once into a closure specialised
+// for its shape, a function pointer with the slots and constants it needs, so running does no switches on types
+// or operators: "slot + constant", "slot = constant", "if slot == constant" each have their own function
+// the variables a statement names are listed when it is compiled, get_state marks those of the statements that ran
+
+#include "interpreter.hpp"
+#include "parser.hpp"
+
+#include <string>
+#include <vector>
+
+namespace sl {
+
+struct expression_closure_t {
+    using call_t = uint8_t (*)(const expression_closure_t&, uint8_t *variables);
+
+    call_t call;
+    const expression_closure_t *left;
+    const expression_closure_t *right;
+    uint32_t slot;      // a variable by symbol id
+    uint32_t operand;   // another slot or a constant, by closure
+    bool effects;       // it assigns somewhere
+};
+
+struct statement_closure_t {
+    // gives the index of the statement to run next
+    using call_t = uint32_t (*)(const statement_closure_t&, uint32_t index, uint8_t *variables);
+
+    call_t call;
+    const expression_closure_t *expression;
+    uint32_t slot;
+    uint32_t operand;
+    uint32_t end;  // of the body of an if
+    uint32_t touched_begin;
+    uint32_t touched_end;
+};
+
+class closure_interpreter_t {
+public:
+    closure_interpreter_t(ast_view_t ast, names_view_t symbols)
+      : _ast(ast), _symbols(symbols), _variables(symbols.size()), _ran(ast.statements.size()), _touched_in(symbols.size(), 0) {
+        // every expression has at most one parent (the parser builds trees, ast_file_view_t::verify checks a loaded file),
+        // so it gives at most one closure and the pointers between them stay valid as they are added
+        _expressions.reserve(ast.expressions.size());
+        _statements.reserve(ast.statements.size());
+        for (uint32_t index = 0; index < ast.statements.size(); index++) {
+            compile_statement(index);
+        }
+        _touched_in = {};
+    }
+
+    // the closures point at each other inside _expressions, a copy would point into the original
+    closure_interpreter_t(const closure_interpreter_t&) = delete;
+    closure_interpreter_t& operator=(const closure_interpreter_t&) = delete;
+
+    bool can_run() {
+        return _next < _statements.size();
+    }
+
+    void run_statement() {
+        const statement_closure_t& statement = _statements[_next];
+        _ran[_next] = 1;
+        _next = statement.call(statement, _next, _variables.data());
+    }
+
+    std::string get_state() {
+        std::vector<bool> live(_variables.size());
+        for (uint32_t index = 0; index < _statements.size(); index++) {
+            if (!_ran[index]) continue;
+            const statement_closure_t& statement = _statements[index];
+            for (uint32_t i = statement.touched_begin; i < statement.touched_end; i++) live[_touched[i]] = true;
+        }
+        return format_state(_symbols, _variables.data(), live);
+    }
+
+private:
+    // what an expression compiled to, numbers and variables only become closures when a generic parent calls them
+    struct operand_t {
+        enum kind_t : uint8_t { e_constant, e_slot, e_closure } kind;
+        uint32_t value;  // the constant or the slot
+        const expression_closure_t *closure;
+    };
+
+    void compile_statement(uint32_t index) {
+        const statement_t& statement = _ast.statements[index];
+        statement_closure_t closure{ nullptr, nullptr, 0, 0, 0, uint32_t(_touched.size()), 0 };
+        switch (statement.type) {
+            case statement_type_t::e_declaration: {
+                touch(statement.id, index);
+                closure.slot = statement.id;
+                if (statement.expression == ast_t::npos) {
+                    closure.call = declare_constant;
+                    break;
+                }
+                operand_t value = compile_expression(statement.expression, index);
+                if (value.kind == operand_t::e_constant) {
+                    closure.call = declare_constant;
+                    closure.operand = value.value;
+                } else if (value.kind == operand_t::e_slot) {
+                    closure.call = declare_slot;
+                    closure.operand = value.value;
+                } else {
+                    closure.call = declare;
+                    closure.expression = value.closure;
+                }
+                break;
+            }
+            case statement_type_t::e_expression: {
+                // without an assignment it changes nothing, only the variables it names are marked
+                size_t closures = _expressions.size();
+                operand_t value = compile_expression(statement.expression, index);
+                if (value.kind == operand_t::e_closure && value.closure->effects) {
+                    closure.call = evaluate;
+                    closure.expression = value.closure;
+                } else {
+                    closure.call = skip;
+                    _expressions.resize(closures);
+                }
+                break;
+            }
+            case statement_type_t::e_if: {
+                closure.end = statement.end;
+                operand_t value = compile_expression(statement.expression, index);
+                if (value.kind == operand_t::e_closure && value.closure->call == equal_slot_constant) {
+                    // the comparison is done by the if itself, its closure was the last one made
+                    closure.call = if_slot_equal_constant;
+                    closure.slot = value.closure->slot;
+                    closure.operand = value.closure->operand;
+                    _expressions.pop_back();
+                } else if (value.kind == operand_t::e_constant) {
+                    closure.call = if_constant;
+                    closure.operand = value.value;
+                } else if (value.kind == operand_t::e_slot) {
+                    closure.call = if_slot;
+                    closure.slot = value.value;
+                } else {
+                    closure.call = if_expression;
+                    closure.expression = value.closure;
+                }
+                break;
+            }
+        }
+        closure.touched_end = _touched.size();
+        _statements.push_back(closure);
+    }
+
+    // also lists the variables it names for the statement
+    operand_t compile_expression(uint32_t index, uint32_t statement) {
+        const expression_t& expression = _ast.expressions[index];
+        switch (expression.type) {
+            case expression_type_t::e_number:
+                return { operand_t::e_constant, uint8_t(expression.as.number), nullptr };
+            case expression_type_t::e_identifier:
+                touch(expression.as.id, statement);
+                return { operand_t::e_slot, expression.as.id, nullptr };
+            case expression_type_t::e_binary:
+                break;
+        }
+
+        operand_t right = compile_expression(expression.as.binary.right, statement);
+        if (expression.op == op_t::e_assign) {
+            uint32_t id = _ast.expressions[expression.as.binary.left].as.id;
+            touch(id, statement);
+            if (right.kind == operand_t::e_constant) return make(assign_constant, nullptr, nullptr, id, right.value);
+            if (right.kind == operand_t::e_slot) return make(assign_slot, nullptr, nullptr, id, right.value);
+            return make(assign, nullptr, right.closure, id, 0);
+        }
+
+        operand_t left = compile_expression(expression.as.binary.left, statement);
+        if (left.kind == operand_t::e_constant && right.kind == operand_t::e_constant) {
+            return { operand_t::e_constant, fold(expression.op, left.value, right.value), nullptr };
+        }
+        // + and == are commutative, numbers and variables have no effects so the order they are read in is free
+        if ((expression.op == op_t::e_plus || expression.op == op_t::e_equal) && left.kind == operand_t::e_constant) {
+            std::swap(left, right);
+        }
+        bool plus = expression.op == op_t::e_plus;
+        bool minus = expression.op == op_t::e_minus;
+        if (left.kind == operand_t::e_slot && right.kind == operand_t::e_constant) {
+            return make(plus ? add_slot_constant : minus ? sub_slot_constant : equal_slot_constant, nullptr, nullptr, left.value, right.value);
+        }
+        if (left.kind == operand_t::e_slot && right.kind == operand_t::e_slot) {
+            return make(plus ? add_slot_slot : minus ? sub_slot_slot : equal_slot_slot, nullptr, nullptr, left.value, right.value);
+        }
+        if (minus && left.kind == operand_t::e_constant && right.kind == operand_t::e_slot) {
+            return make(sub_from_constant_slot, nullptr, nullptr, right.value, left.value);
+        }
+        if (right.kind == operand_t::e_constant) {
+            return make(plus ? add_constant : minus ? sub_constant : equal_constant, closure_of(left), nullptr, 0, right.value);
+        }
+        return make(plus ? add : minus ? sub : equal, closure_of(left), closure_of(right), 0, 0);
+    }
+
+    static uint8_t fold(op_t op, uint32_t left, uint32_t right) {
+        switch (op) {
+            case op_t::e_plus:
+                return left + right;
+            case op_t::e_minus:
+                return left - right;
+            case op_t::e_equal:
+                return left == right;
+            default:
+                return 0;
+        }
+    }
+
+    operand_t make(expression_closure_t::call_t call, const expression_closure_t *left, const expression_closure_t *right, uint32_t slot, uint32_t operand) {
+        bool effects = (left && left->effects) || (right && right->effects) || call == assign_constant || call == assign_slot || call == assign;
+        _expressions.push_back({ call, left, right, slot, operand, effects });
+        return { operand_t::e_closure, 0, &_expressions.back() };
+    }
+
+    const expression_closure_t *closure_of(operand_t operand) {
+        if (operand.kind == operand_t::e_constant) return make(constant, nullptr, nullptr, 0, operand.value).closure;
+        if (operand.kind == operand_t::e_slot) return make(slot, nullptr, nullptr, operand.value, 0).closure;
+        return operand.closure;
+    }
+
+    // the variable is named by the statement, listed once
+    void touch(uint32_t id, uint32_t statement) {
+        if (_touched_in[id] == statement + 1) return;
+        _touched_in[id] = statement + 1;
+        _touched.push_back(id);
+    }
+
+    // the closures, the right side is evaluated before the left one like interpreter_t does
+
+    static uint8_t constant(const expression_closure_t& c, uint8_t *) { return c.operand; }
+    static uint8_t slot(const expression_closure_t& c, uint8_t *v) { return v[c.slot]; }
+
+    static uint8_t assign_constant(const expression_closure_t& c, uint8_t *v) { return v[c.slot] = c.operand; }
+    static uint8_t assign_slot(const expression_closure_t& c, uint8_t *v) { return v[c.slot] = v[c.operand]; }
+    static uint8_t assign(const expression_closure_t& c, uint8_t *v) { return v[c.slot] = c.right->call(*c.right, v); }
+
+    static uint8_t add_slot_constant(const expression_closure_t& c, uint8_t *v) { return v[c.slot] + c.operand; }
+    static uint8_t add_slot_slot(const expression_closure_t& c, uint8_t *v) { return v[c.slot] + v[c.operand]; }
+    static uint8_t add_constant(const expression_closure_t& c, uint8_t *v) { return c.left->call(*c.left, v) + c.operand; }
+    static uint8_t add(const expression_closure_t& c, uint8_t *v) {
+        uint8_t right = c.right->call(*c.right, v);
+        return c.left->call(*c.left, v) + right;
+    }
+
+    static uint8_t sub_slot_constant(const expression_closure_t& c, uint8_t *v) { return v[c.slot] - c.operand; }
+    static uint8_t sub_from_constant_slot(const expression_closure_t& c, uint8_t *v) { return c.operand - v[c.slot]; }
+    static uint8_t sub_slot_slot(const expression_closure_t& c, uint8_t *v) { return v[c.slot] - v[c.operand]; }
+    static uint8_t sub_constant(const expression_closure_t& c, uint8_t *v) { return c.left->call(*c.left, v) - c.operand; }
+    static uint8_t sub(const expression_closure_t& c, uint8_t *v) {
+        uint8_t right = c.right->call(*c.right, v);
+        return c.left->call(*c.left, v) - right;
+    }
+
+    static uint8_t equal_slot_constant(const expression_closure_t& c, uint8_t *v) { return v[c.slot] == c.operand; }
+    static uint8_t equal_slot_slot(const expression_closure_t& c, uint8_t *v) { return v[c.slot] == v[c.operand]; }
+    static uint8_t equal_constant(const expression_closure_t& c, uint8_t *v) { return c.left->call(*c.left, v) == c.operand; }
+    static uint8_t equal(const expression_closure_t& c, uint8_t *v) {
+        uint8_t right = c.right->call(*c.right, v);
+        return c.left->call(*c.left, v) == right;
+    }
+
+    static uint32_t declare_constant(const statement_closure_t& s, uint32_t index, uint8_t *v) {
+        v[s.slot] = s.operand;
+        return index + 1;
+    }
+    static uint32_t declare_slot(const statement_closure_t& s, uint32_t index, uint8_t *v) {
+        v[s.slot] = v[s.operand];
+        return index + 1;
+    }
+    static uint32_t declare(const statement_closure_t& s, uint32_t index, uint8_t *v) {
+        v[s.slot] = s.expression->call(*s.expression, v);
+        return index + 1;
+    }
+    static uint32_t evaluate(const statement_closure_t& s, uint32_t index, uint8_t *v) {
+        s.expression->call(*s.expression, v);
+        return index + 1;
+    }
+    static uint32_t skip(const statement_closure_t&, uint32_t index, uint8_t *) {
+        return index + 1;
+    }
+    static uint32_t if_slot_equal_constant(const statement_closure_t& s, uint32_t index, uint8_t *v) {
+        return v[s.slot] == s.operand ? index + 1 : s.end;
+    }
+    static uint32_t if_slot(const statement_closure_t& s, uint32_t index, uint8_t *v) {
+        return v[s.slot] ? index + 1 : s.end;
+    }
+    static uint32_t if_constant(const statement_closure_t& s, uint32_t index, uint8_t *) {
+        return s.operand ? index + 1 : s.end;
+    }
+    static uint32_t if_expression(const statement_closure_t& s, uint32_t index, uint8_t *v) {
+        return s.expression->call(*s.expression, v) ? index + 1 : s.end;
+    }
+
+private:
+    ast_view_t _ast;  // the ast and the names it views must outlive this
+    names_view_t _symbols;
+
+    std::vector<expression_closure_t> _expressions;
+    std::vector<statement_closure_t> _statements;  // by statement index
+    std::vector<uint32_t> _touched;                // the variables each statement names, see statement_closure_t
+
+    std::vector<uint8_t> _variables;  // by symbol id
+    std::vector<uint8_t> _ran;  // by statement index
+    std::vector<uint32_t> _touched_in;  // by symbol id, 1 + the statement that last listed it, while compiling
+
+    uint32_t _next{ 0 };
+};
+
+} // namespace sl
+
+#endif
@@ -7,139 +7,151 @@ namespace sl {
 
 class code_gen_t {
 public:
-    code_gen_t(const ast_t& ast) : _ast(ast) {}
+    static constexpr uint32_t no_offset = ~0u;
+
+    code_gen_t(ast_view_t ast, names_view_t symbols) : _ast(ast), variable_offset(symbols.size(), no_offset), temp_offset(symbols.size()) {}
+
+    // for a part of a program generated on its own, see incremental.hpp, the offsets are by symbol id of the part:
+    // the address of the variables declared before it and no_offset for the ones it declares, which get
+    // next_offset onwards, temp_offset and section_number are where the whole program has them at its start
+    code_gen_t(ast_view_t ast, std::vector<uint32_t> offsets, uint32_t next_offset, uint32_t temp_offset, uint32_t section_number)
+      : _ast(ast), variable_offset(std::move(offsets)), next_offset(next_offset), temp_offset(temp_offset), section_number(section_number) {}
     
     std::string gen() {
-        s << ".text\n";
+        s << header;
+        gen_block(0, _ast.statements.size());
+        s << footer;
+        return s.str();
+    }
+
+    // the code of the statements alone, gen() is header, this and footer
+    std::string gen_statements() {
+        gen_block(0, _ast.statements.size());
+        return s.str();
+    }
+
+    static constexpr std::string_view header = ".text\n\nstart:\n";
+    static constexpr std::string_view footer = "\thlt\n";
 
-        s << "\nstart:\n";
-        for (auto& statement : _ast.statements) {
-            switch (statement->type) {
+private:
+    // statements [begin, end) of one block, nested bodies are emitted by gen_if
+    void gen_block(uint32_t begin, uint32_t end) {
+        for (uint32_t index = begin; index < end; index = _ast.next(index)) {
+            const statement_t& statement = _ast.statements[index];
+            switch (statement.type) {
                 case statement_type_t::e_declaration:
-                    gen_declaration(statement->as.declaration);
+                    gen_declaration(statement);
                     break;
                 case statement_type_t::e_expression:
-                    gen_expression(statement->as.expression);
+                    gen_expression(statement.expression, true);
                     s << "\t\n"; 
                     break;
                 case statement_type_t::e_if:
-                    gen_if(statement->as._if);
+                    gen_if(index);
                     s << "\t\n"; 
                     break;
             }
         }
-        s << "\thlt\n";
-        return s.str();
     }
 
-private:
-    void gen_declaration(declaration_t *declaration) {
-        if (declaration->type == declaration_type_t::e_simple) {
-            variable_offset[declaration->as.simple.identifier->id] = variable_offset.size();
-        } else {
-            // throw std::runtime_error("complex declaration not implemented");
-            expression_t left_expression{};
-            left_expression.type = expression_type_t::e_unary;
-            left_expression.as.unary.type = unary_type_t::e_identifier;
-            left_expression.as.unary.as.identifier = declaration->as.complex.identifier;
-            token_t assign_op = token_t{ .type = token_type_t::e_assign };
-            expression_t expression{};
-            expression.type = expression_type_t::e_binary;
-            expression.as.binary.left_expression = &left_expression;
-            expression.as.binary.op = &assign_op;
-            expression.as.binary.right_expression = declaration->as.complex.expression;
-            gen_expression(&expression);
+    void gen_declaration(const statement_t& declaration) {
+        variable_offset[declaration.id] = next_offset++;
+        if (declaration.expression != ast_t::npos) {
+            gen_expression(declaration.expression);
+            s << "\tmov M A " << variable_offset[declaration.id] << '\n';
         }
     }
 
-    std::string get_register() {
-        if (register_counter == 1) return "A";
-        if (register_counter == 2) return "B";
-        throw std::runtime_error("unexpected error");
+    bool is_unary(const expression_t& expression) {
+        return expression.type != expression_type_t::e_binary;
     }
 
-    void gen_expression(expression_t *expression) {
-        if (expression->type == expression_type_t::e_unary) {
-            register_counter++;
-            if (expression->as.unary.type == unary_type_t::e_number) {
-                s << "\tldi " << get_register() << " " << expression->as.unary.as.number->number << '\n';
-            } else {
-                s << "\tmov " << get_register() << " " << "M " << variable_offset[expression->as.unary.as.identifier->id] << '\n';
-            }
-            return;
+    void load(const char *reg, const expression_t& expression) {
+        if (expression.type == expression_type_t::e_number) {
+            s << "\tldi " << reg << " " << expression.as.number << '\n';
         } else {
-            if (expression->as.binary.op->type == token_type_t::e_assign) {
-                gen_expression(expression->as.binary.right_expression);
-                if (expression->as.binary.left_expression->as.unary.type == unary_type_t::e_number) {
-                    throw std::runtime_error("cannot assign a number to another number");
-                } else {
-                    s << "\tmov M " << "A" << " " << variable_offset[expression->as.binary.left_expression->as.unary.as.identifier->id] << '\n';
-                }
-            } else if (expression->as.binary.op->type == token_type_t::e_plus) {
-                gen_expression(expression->as.binary.right_expression);
-                register_counter++;
-                if (expression->as.binary.left_expression->as.unary.type == unary_type_t::e_number) {
-                    s << "\tldi " << get_register() << " " << expression->as.binary.left_expression->as.unary.as.number->number << '\n';
-                } else {
-                    s << "\tmov " << get_register() << " M " << variable_offset[expression->as.binary.left_expression->as.unary.as.identifier->id] << '\n';
-                }
-                s << "\tadd\n"; 
-            } else if (expression->as.binary.op->type == token_type_t::e_minus) {
-                gen_expression(expression->as.binary.left_expression);
-                register_counter++;
-                if (expression->as.binary.right_expression->as.unary.type == unary_type_t::e_number) {
-                    s << "\tldi " << get_register() << " " << expression->as.binary.right_expression->as.unary.as.number->number << '\n';
-                } else {
-                    s << "\tmov " << get_register() << " M " << variable_offset[expression->as.binary.right_expression->as.unary.as.identifier->id] << '\n';
-                }
-                s << "\tsub\n"; 
-            } else if (expression->as.binary.op->type == token_type_t::e_equal) {
-                gen_expression(expression->as.binary.right_expression);
-                register_counter++;
-                if (expression->as.binary.left_expression->as.unary.type == unary_type_t::e_number) {
-                    s << "\tldi " << get_register() << " " << expression->as.binary.left_expression->as.unary.as.number->number << '\n';
-                } else {
-                    s << "\tmov " << get_register() << " M " << variable_offset[expression->as.binary.left_expression->as.unary.as.identifier->id] << '\n';
-                }
-                s << "\tcmp\n"; 
+            s << "\tmov " << reg << " M " << variable_offset[expression.as.id] << '\n';
+        }
+    }
+
+    // leaves the value of expression in A, B is scratch
+    // when neither side of an operator is a leaf the right side is spilled to a temporary past the variables
+    // == only sets the flag jne reads, not a 0/1 value in A, so it may only be the condition of an if or a
+    // statement whose value is dropped, top is whether index is one of those
+    void gen_expression(uint32_t index, bool top = false) {
+        const expression_t& expression = _ast.expressions[index];
+        if (is_unary(expression)) {
+            load("A", expression);
+            return;
+        }
+
+        const expression_t& left = _ast.expressions[expression.as.binary.left];
+        const expression_t& right = _ast.expressions[expression.as.binary.right];
+        op_t op = expression.op;
+        if (op == op_t::e_equal && !top) {
+            throw std::runtime_error("the asm has no value for ==, it can only be the condition of an if");
+        }
+
+        if (op == op_t::e_assign) {
+            gen_expression(expression.as.binary.right);
+            if (left.type != expression_type_t::e_identifier) {
+                throw std::runtime_error("cannot assign a number to another number");
             }
-            
-            register_counter--;
+            s << "\tmov M A " << variable_offset[left.as.id] << '\n';
             return;
         }
-    }
 
+        bool commutative = op == op_t::e_plus || op == op_t::e_equal;
+        if (commutative && is_unary(left)) {
+            gen_expression(expression.as.binary.right);
+            load("B", left);
+        } else if (is_unary(right)) {
+            gen_expression(expression.as.binary.left);
+            load("B", right);
+        } else {
+            uint32_t temp = temp_offset + temp_depth++;
+            gen_expression(expression.as.binary.right);
+            s << "\tmov M A " << temp << '\n';
+            gen_expression(expression.as.binary.left);
+            s << "\tmov B M " << temp << '\n';
+            temp_depth--;
+        }
+
+        switch (op) {
+            case op_t::e_plus:
+                s << "\tadd\n";
+                break;
+            case op_t::e_minus:
+                s << "\tsub\n";
+                break;
+            case op_t::e_equal:
+                s << "\tcmp\n";
+                break;
+            default:
+                throw std::runtime_error("unexpected operator");
+        }
+    }
 
-    void gen_if(if_t *_if) {
-        gen_expression(_if->expression);
+    void gen_if(uint32_t index) {
+        const statement_t& _if = _ast.statements[index];
+        gen_expression(_if.expression, true);
         s << "\t\n"; 
-        s << "\tjne %section" << section_number << '\n';
+        uint32_t section = section_number++;  // taken before the body so nested ifs get their own label
+        s << "\tjne %section" << section << '\n';
         s << "\t\n"; 
-        register_counter--; // ??
-        for (auto& statement : _if->truthy) {
-            switch (statement->type) {
-                case statement_type_t::e_declaration:
-                    gen_declaration(statement->as.declaration);
-                    break;
-                case statement_type_t::e_expression:
-                    gen_expression(statement->as.expression);
-                    s << "\t\n"; 
-                    break;
-                case statement_type_t::e_if:
-                    gen_if(statement->as._if);
-                    s << "\t\n"; 
-                    break;
-            }
-        }
-        s << "section" << section_number++ << ":" << '\n';
+        gen_block(index + 1, _if.end);
+        s << "section" << section << ":" << '\n';
     }
 
 private:
-    ast_t _ast;
-    std::map<uint32_t, uint32_t> variable_offset;
+    ast_view_t _ast;  // the ast it views must outlive this
+
+    std::vector<uint32_t> variable_offset;  // indexed by symbol id, memory address of each variable
+    uint32_t next_offset{ 0 };
     std::stringstream s;
 
-    uint32_t register_counter{ 0 };
+    uint32_t temp_offset;  // temporaries live right after the variables
+    uint32_t temp_depth{ 0 };
     uint32_t section_number{ 0 };
 };
 
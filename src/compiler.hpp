@@ -0,0 +1,213 @@
+#ifndef COMPILER_HPP
+#define COMPILER_HPP
+
+// the whole pipeline for one source, lexer -> parser -> code gen, as used by the command line driver
+
+#include "lexer.hpp"
+#include "parser.hpp"
+#include "parallel_parser.hpp"
+#include "bytecode.hpp"
+#include "closure_interpreter.hpp"
+#include "jit.hpp"
+#include "interpreter.hpp"
+#include "code_gen.hpp"
+#include "cache.hpp"
+#include "ast_file.hpp"
+
+#include <chrono>
+#include <cstring>
+#include <istream>
+#include <optional>
+#include <stdexcept>
+#include <tuple>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace sl {
+
+// how compile_options_t::run runs the program, all give the same state
+enum class run_engine_t : uint8_t {
+    e_tree,      // interpreter_t
+    e_bytecode,  // bytecode_vm_t, see bytecode.hpp
+    e_closure,   // closure_interpreter_t
+    e_jit,       // jit_t, the bytecode as machine code where it can be
+};
+
+struct compile_options_t {
+    lexer_engine_t engine{ lexer_engine_t::e_hand_written };
+    bool run{ false };  // output the state of the program after running it instead of the asm
+    bool emit_ast{ false };  // output the ast file of the program instead, see ast_file.hpp
+    run_engine_t run_engine{ run_engine_t::e_tree };
+};
+
+struct compile_timings_t {
+    uint64_t lex_ns{ 0 };
+    uint64_t parse_ns{ 0 };
+    uint64_t gen_ns{ 0 };  // or running the program with compile_options_t::run
+    bool cached{ false };  // the output came from the cache, nothing was lexed or parsed
+};
+
+// part of every cache key, bump it whenever the output for the same source and options changes
+inline constexpr uint64_t compiler_version = 1;
+
+// the lexer and run engines are left out, each produces the same output as the others
+inline cache_key_t cache_key(std::string_view source, const compile_options_t& options) {
+    return hasher_t{}.add(compiler_version).add(uint64_t(options.run)).add(uint64_t(options.emit_ast)).add(source).key();
+}
+
+// compiles one source at a time, the token buffer, the ast and the symbol table are kept from one compile
+// to the next so a long running process (see server.hpp) stops allocating them once they are warm
+class compiler_t {
+public:
+    // the asm of source, or line:column: message
+    // source may also be an ast file (see ast_file.hpp), which is checked and used in place of lexing and parsing
+    // with a pool the parse is split over it, see parallel_parser_t, it must not be called from one of its jobs then
+    Result<std::string, std::string> compile(std::string_view source, const compile_options_t& options = {}, thread_pool_t *pool = nullptr) {
+        _timings = {};
+        if (!_cache) return compile_uncached(source, options, pool);
+
+        cache_key_t key = cache_key(source, options);
+        if (std::optional<std::string> output = _cache->lookup(key)) {
+            _timings.cached = true;
+            return Ok(std::move(*output));
+        }
+        Result<std::string, std::string> result = compile_uncached(source, options, pool);
+        // only outputs are cached, an error is found again
+        if (result) _cache->store(key, result.unwrap());
+        return result;
+    }
+
+    // looked up before and stored after every compile, nullptr turns it off, the cache must outlive the compiles
+    void use_cache(cache_t *cache) {
+        _cache = cache;
+    }
+
+    // of the last compile
+    const compile_timings_t& timings() const {
+        return _timings;
+    }
+
+    // the asm of a parsed program, or its state after running it with options.run
+    static std::string generate(ast_view_t ast, names_view_t names, const compile_options_t& options) {
+        if (options.run && options.run_engine == run_engine_t::e_bytecode) {
+            bytecode_t bytecode = bytecode_gen_t{ ast, names }.gen();
+            bytecode_vm_t vm{ bytecode, names };
+            vm.run();
+            return vm.get_state();
+        }
+        if (options.run && options.run_engine == run_engine_t::e_jit) {
+            bytecode_t bytecode = bytecode_gen_t{ ast, names }.gen();
+            jit_t jit{ bytecode, names };
+            jit.run();
+            return jit.get_state();
+        }
+        if (options.run && options.run_engine == run_engine_t::e_closure) {
+            closure_interpreter_t interpreter{ ast, names };
+            return run(interpreter);
+        }
+        if (options.run) {
+            interpreter_t interpreter{ ast, names };
+            return run(interpreter);
+        }
+        code_gen_t code_gen{ ast, names };
+        return code_gen.gen() + '\n';
+    }
+
+private:
+    Result<std::string, std::string> compile_uncached(std::string_view source, const compile_options_t& options, thread_pool_t *pool) {
+        using clock_t = std::chrono::steady_clock;
+        try {
+            clock_t::time_point start = clock_t::now();
+            if (is_ast_file(source)) {
+                if (options.emit_ast) return Ok(std::string(source));
+                // the view reads the arrays in place, bytes from a caller (sl_compile, a request) may sit anywhere
+                if (reinterpret_cast<uintptr_t>(source.data()) % alignof(uint64_t)) {
+                    _aligned.resize((source.size() + sizeof(uint64_t) - 1) / sizeof(uint64_t));
+                    std::memcpy(_aligned.data(), source.data(), source.size());
+                    source = { reinterpret_cast<const char *>(_aligned.data()), source.size() };
+                }
+                ast_file_view_t file{ source };
+                file.verify();
+                clock_t::time_point loaded = clock_t::now();
+                _timings.parse_ns = elapsed(start, loaded);
+                std::string output = generate(file.ast(), file.names(), options);
+                _timings.gen_ns = elapsed(loaded, clock_t::now());
+                return Ok(std::move(output));
+            }
+
+            lexer_t lexer{ source, options.engine };
+            lexer.tokens(_tokens);
+            clock_t::time_point lexed = clock_t::now();
+            _timings.lex_ns = elapsed(start, lexed);
+
+            Result<std::pair<ast_t, symbol_table_t>, error_t> result = pool ? parallel_parser_t{ _tokens, source, *pool }.parse() : parse(source);
+            clock_t::time_point parsed = clock_t::now();
+            _timings.parse_ns = elapsed(lexed, parsed);
+            if (!result) return Err(result.unwrapErr().message(source));
+
+            std::tie(_ast, _symbols) = result.take();
+
+            std::string output = options.emit_ast ? write_ast(_ast, _symbols) : generate(_ast, _symbols, options);
+            _timings.gen_ns = elapsed(parsed, clock_t::now());
+            return Ok(std::move(output));
+        } catch (const std::runtime_error& error) {
+            // the lexer and the code generator throw, and so does a damaged ast file
+            return Err(std::string(error.what()));
+        }
+    }
+
+    template <typename interpreter_type_t>
+    static std::string run(interpreter_type_t& interpreter) {
+        while (interpreter.can_run()) {
+            interpreter.run_statement();
+        }
+        return interpreter.get_state();
+    }
+
+    Result<std::pair<ast_t, symbol_table_t>, error_t> parse(std::string_view source) {
+        parser_t parser{ _tokens, source };
+        parser.reuse(std::move(_ast), std::move(_symbols));
+        return parser.parse();
+    }
+
+    static uint64_t elapsed(std::chrono::steady_clock::time_point from, std::chrono::steady_clock::time_point to) {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(to - from).count();
+    }
+
+private:
+    token_buffer_t _tokens;
+    std::vector<uint64_t> _aligned;  // a copy of an ast file that was not 8 byte aligned
+    ast_t _ast;
+    symbol_table_t _symbols;
+    compile_timings_t _timings;
+    cache_t *_cache{ nullptr };
+};
+
+// a one off compile, see compiler_t::compile and compiler_t::use_cache
+inline Result<std::string, std::string> compile(std::string_view source, const compile_options_t& options = {}, thread_pool_t *pool = nullptr, cache_t *cache = nullptr) {
+    compiler_t compiler;
+    compiler.use_cache(cache);
+    return compiler.compile(source, options, pool);
+}
+
+// compile for sources too large to hold in memory, input is lexed and parsed as it is read so only the ast is kept
+// whole, errors give the offset instead of line:column as the source is gone by then; not for ast files
+inline Result<std::string, std::string> compile_stream(std::istream& input, const compile_options_t& options = {}, size_t chunk_size = 64 * 1024) {
+    try {
+        stream_lexer_t lexer{ input, chunk_size, options.engine };
+        stream_parser_t parser{ lexer };
+        Result<std::pair<ast_t, symbol_table_t>, error_t> result = parser.parse();
+        if (!result) return Err(result.unwrapErr().message());
+        if (input.bad()) return Err(std::string("failed to read source"));
+        auto [ast, symbols] = result.take();
+        if (options.emit_ast) return Ok(write_ast(ast, symbols));
+        return Ok(compiler_t::generate(ast, symbols, options));
+    } catch (const std::runtime_error& error) {
+        return Err(std::string(error.what()));
+    }
+}
+
+} // namespace sl
+
+#endif
@@ -0,0 +1,299 @@
+#ifndef DFA_LEXER_HPP
+#define DFA_LEXER_HPP
+
+// table driven lexer engine, the character classes, the transition table and the keyword hash
+// are generated at compile time from token_specs, adding a token only grows the tables
+
+#include "token.hpp"
+
+#include <array>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+
+namespace sl {
+
+namespace dfa {
+
+struct token_spec_t {
+    std::string_view text;
+    token_type_t type;
+};
+
+// keywords start with a letter, everything else is an operator matched by the dfa
+// identifiers, numbers, whitespace and comments are built into the dfa
+inline constexpr token_spec_t token_specs[] = {
+    { "int", token_type_t::e_int },
+    { "if", token_type_t::e_if },
+
+    { "=", token_type_t::e_assign },
+    { "+", token_type_t::e_plus },
+    { "-", token_type_t::e_minus },
+    { "==", token_type_t::e_equal },
+    { "{", token_type_t::e_lbrace },
+    { "}", token_type_t::e_rbrace },
+    { "(", token_type_t::e_lbracket },
+    { ")", token_type_t::e_rbracket },
+    { ";", token_type_t::e_semicolon },
+};
+
+constexpr bool is_alpha(char c) {
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z');
+}
+
+constexpr bool is_keyword(const token_spec_t& spec) {
+    return is_alpha(spec.text[0]);
+}
+
+// character classes, operator characters get one class each starting at c_operator
+enum class_t : uint8_t {
+    c_other,
+    c_space,
+    c_newline,
+    c_alpha,
+    c_digit,
+    c_slash,
+    c_operator,
+};
+
+// states, operator prefixes get one state each starting at s_operator, s_dead stops the dfa
+enum state_t : uint8_t {
+    s_dead,
+    s_start,
+    s_space,
+    s_comment,
+    s_identifier,
+    s_number,
+    s_operator,
+};
+
+enum accept_t : uint8_t {
+    a_none,
+    a_skip,   // whitespace and comments
+    a_word,   // identifier or keyword
+    a_token,  // accept_types holds the token type
+};
+
+// distinct characters used by operators, in order of first use
+struct operator_chars_t {
+    std::array<char, 256> chars{};
+    size_t count{ 0 };
+};
+
+constexpr operator_chars_t operator_chars() {
+    operator_chars_t result{};
+    for (const token_spec_t& spec : token_specs) {
+        if (is_keyword(spec)) continue;
+        for (char c : spec.text) {
+            bool seen = false;
+            for (size_t i = 0; i < result.count; i++) seen |= result.chars[i] == c;
+            if (!seen) result.chars[result.count++] = c;
+        }
+    }
+    return result;
+}
+
+// distinct operator prefixes, each is a state of the dfa
+struct operator_prefixes_t {
+    std::array<std::string_view, 256> prefixes{};
+    size_t count{ 0 };
+};
+
+constexpr operator_prefixes_t operator_prefixes() {
+    operator_prefixes_t result{};
+    for (const token_spec_t& spec : token_specs) {
+        if (is_keyword(spec)) continue;
+        for (size_t length = 1; length <= spec.text.size(); length++) {
+            std::string_view prefix = spec.text.substr(0, length);
+            bool seen = false;
+            for (size_t i = 0; i < result.count; i++) seen |= result.prefixes[i] == prefix;
+            if (!seen) result.prefixes[result.count++] = prefix;
+        }
+    }
+    return result;
+}
+
+inline constexpr size_t class_count = c_operator + operator_chars().count;
+inline constexpr size_t state_count = s_operator + operator_prefixes().count;
+
+static_assert(class_count <= 256 && state_count <= 256, "classes and states are stored in bytes");
+
+struct tables_t {
+    std::array<uint8_t, 256> classes{};
+    std::array<std::array<uint8_t, class_count>, state_count> transitions{};
+    std::array<uint8_t, state_count> accepts{};
+    std::array<token_type_t, state_count> accept_types{};
+};
+
+constexpr tables_t make_tables() {
+    tables_t tables{};
+    operator_chars_t chars = operator_chars();
+    operator_prefixes_t prefixes = operator_prefixes();
+
+    for (int c = 0; c < 256; c++) {
+        uint8_t char_class = c_other;
+        if (c == ' ' || c == '\t' || c == '\v' || c == '\f' || c == '\r') char_class = c_space;
+        if (c == '\n') char_class = c_newline;
+        if (is_alpha(c)) char_class = c_alpha;
+        if (c >= '0' && c <= '9') char_class = c_digit;
+        if (c == '/') char_class = c_slash;
+        for (size_t i = 0; i < chars.count; i++) {
+            if (chars.chars[i] == char(c)) char_class = c_operator + i;
+        }
+        tables.classes[c] = char_class;
+    }
+
+    auto& t = tables.transitions;
+    t[s_start][c_space] = s_space;
+    t[s_start][c_newline] = s_space;
+    t[s_start][c_alpha] = s_identifier;
+    t[s_start][c_digit] = s_number;
+    t[s_start][c_slash] = s_comment;
+    t[s_space][c_space] = s_space;
+    t[s_space][c_newline] = s_space;
+    for (size_t c = 0; c < class_count; c++) {
+        if (c != c_newline) t[s_comment][c] = s_comment;
+    }
+    t[s_identifier][c_alpha] = s_identifier;
+    t[s_identifier][c_digit] = s_identifier;
+    t[s_number][c_digit] = s_number;
+
+    tables.accepts[s_space] = a_skip;
+    tables.accepts[s_comment] = a_skip;
+    tables.accepts[s_identifier] = a_word;
+    tables.accepts[s_number] = a_token;
+    tables.accept_types[s_number] = token_type_t::e_number;
+
+    auto state_of = [&](std::string_view prefix) -> uint8_t {
+        for (size_t i = 0; i < prefixes.count; i++) {
+            if (prefixes.prefixes[i] == prefix) return s_operator + i;
+        }
+        return s_dead;
+    };
+    for (size_t i = 0; i < prefixes.count; i++) {
+        std::string_view prefix = prefixes.prefixes[i];
+        uint8_t from = prefix.size() == 1 ? uint8_t(s_start) : state_of(prefix.substr(0, prefix.size() - 1));
+        uint8_t char_class = tables.classes[uint8_t(prefix.back())];
+        t[from][char_class] = s_operator + i;
+        for (const token_spec_t& spec : token_specs) {
+            if (!is_keyword(spec) && spec.text == prefix) {
+                tables.accepts[s_operator + i] = a_token;
+                tables.accept_types[s_operator + i] = spec.type;
+            }
+        }
+    }
+    return tables;
+}
+
+inline constexpr tables_t tables = make_tables();
+
+// perfect hash over the keywords, a multiplicative hash of first char, last char and length
+// with a multiplier searched at compile time so that no two keywords share a slot
+
+constexpr size_t keyword_count() {
+    size_t count = 0;
+    for (const token_spec_t& spec : token_specs) count += is_keyword(spec);
+    return count;
+}
+
+inline constexpr uint32_t keyword_bits = [] {
+    uint32_t bits = 1;
+    while ((size_t(1) << bits) < 2 * keyword_count()) bits++;
+    return bits;
+}();
+
+constexpr uint32_t keyword_hash(const char *word, size_t length, uint32_t seed) {
+    uint32_t key = uint8_t(word[0]) | uint8_t(word[length - 1]) << 8 | uint32_t(length) << 16;
+    return (key * seed) >> (32 - keyword_bits);
+}
+
+struct keyword_table_t {
+    uint32_t seed{ 0 };
+    std::array<uint8_t, size_t(1) << keyword_bits> slots{};  // index into token_specs + 1, 0 is empty
+};
+
+constexpr keyword_table_t make_keyword_table() {
+    for (uint32_t seed = 0x9e3779b1; seed < 0x9e3779b1 + 2 * 65536; seed += 2) {
+        keyword_table_t table{};
+        table.seed = seed;
+        bool collision = false;
+        for (size_t i = 0; i < std::size(token_specs) && !collision; i++) {
+            if (!is_keyword(token_specs[i])) continue;
+            uint32_t slot = keyword_hash(token_specs[i].text.data(), token_specs[i].text.size(), seed);
+            collision = table.slots[slot] != 0;
+            table.slots[slot] = i + 1;
+        }
+        if (!collision) return table;
+    }
+    return {};
+}
+
+inline constexpr keyword_table_t keyword_table = make_keyword_table();
+
+static_assert(keyword_table.seed != 0, "no perfect hash found for the keywords");
+
+inline token_type_t classify_word(const char *word, size_t length) {
+    uint8_t slot = keyword_table.slots[keyword_hash(word, length, keyword_table.seed)];
+    if (slot) {
+        std::string_view keyword = token_specs[slot - 1].text;
+        if (keyword == std::string_view{ word, length }) return token_specs[slot - 1].type;
+    }
+    return token_type_t::e_identifier;
+}
+
+// same contract as sl::lex_token
+inline lex_step_t lex_token(const char *pos, const char *end, bool partial, bool& in_comment) {
+    uint8_t state = in_comment ? uint8_t(s_comment) : uint8_t(s_start);
+    in_comment = false;
+    const char *start = pos;
+    while (true) {
+        // longest match, remembering the last accepting state in case the dfa has to back off
+        uint8_t accepted = tables.accepts[state] ? state : uint8_t(s_dead);
+        const char *accepted_end = pos;
+        while (pos != end) {
+            uint8_t next = tables.transitions[state][tables.classes[uint8_t(*pos)]];
+            if (next == s_dead) break;
+            state = next;
+            pos++;
+            if (tables.accepts[state]) {
+                accepted = state;
+                accepted_end = pos;
+            }
+        }
+
+        if (pos == end && partial && state != s_start) {
+            if (state == s_space) return { lex_status_t::e_more, token_type_t::e_undefined, end, end };
+            if (state == s_comment) {
+                in_comment = true;
+                return { lex_status_t::e_more, token_type_t::e_undefined, end, end };
+            }
+            return { lex_status_t::e_more, token_type_t::e_undefined, start, end };
+        }
+        if (pos == start && state == s_start) {
+            if (pos == end) break;
+            throw std::runtime_error(std::string("unexpected char ") + *pos);
+        }
+
+        switch (tables.accepts[accepted]) {
+            case a_skip:
+                start = pos = accepted_end;
+                state = s_start;
+                continue;
+            case a_word:
+                return { lex_status_t::e_token, classify_word(start, accepted_end - start), start, accepted_end };
+            case a_token:
+                return { lex_status_t::e_token, tables.accept_types[accepted], start, accepted_end };
+            default:
+                throw std::runtime_error(std::string("unexpected char ") + *start);
+        }
+    }
+    if (partial) return { lex_status_t::e_more, token_type_t::e_undefined, end, end };
+    return { lex_status_t::e_end, token_type_t::e_end, end, end };
+}
+
+} // namespace dfa
+
+} // namespace sl
+
+#endif
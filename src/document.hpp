@@ -0,0 +1,397 @@
+#ifndef DOCUMENT_HPP
+#define DOCUMENT_HPP
+
+// a source open in an editor, checked as it is typed, see lsp.hpp
+// the document is kept as its top level statements, units, each lexed and parsed on its own like in
+// incremental.hpp, an edit lexes from the unit it starts in until a unit ends where an old one ended and parses
+// the units lexed plus the ones naming a variable whose declaration the edit added or removed
+// errors do not stop the check, every unit reports its own, so a statement being typed does not hide the rest
+
+#include "lexer.hpp"
+#include "parser.hpp"
+
+#include <algorithm>
+#include <memory>
+#include <set>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace sl {
+
+struct diagnostic_t {
+    uint64_t offset;  // of the bytes it is about
+    uint64_t length;
+    std::string message;
+};
+
+struct document_stats_t {
+    size_t units{ 0 };          // top level statements of the document
+    size_t relexed_bytes{ 0 };  // by the last edit
+    size_t reparsed{ 0 };       // units parsed by the last edit, the ones it touched and the ones depending on them
+};
+
+class document_t {
+public:
+    explicit document_t(std::string_view text, lexer_engine_t engine = lexer_engine_t::e_hand_written) : _engine(engine) {
+        edit(0, 0, text);
+    }
+
+    // replaces the bytes [begin, end) with text and checks what that changed
+    void edit(uint64_t begin, uint64_t end, std::string_view text) {
+        end = std::min<uint64_t>(end, _text.size());
+        begin = std::min(begin, end);
+        _stats = {};
+        update_lines(begin, end, text);
+        _text.replace(begin, end - begin, text);
+        int64_t delta = int64_t(text.size()) - int64_t(end - begin);
+
+        // the units ending before the edit stay, but an unterminated one runs into whatever follows it
+        size_t first = std::upper_bound(_spans.begin(), _spans.end(), begin, [](uint64_t position, const span_t& span) { return position < span.end; }) - _spans.begin();
+        if (first && !_units[first - 1]->terminated) first--;
+        uint64_t start = first ? _spans[first - 1].end : 0;
+
+        // lex until a unit ends in the bytes after the edit where an old one ended, the units after that one stay
+        std::vector<pending_t> pending;
+        size_t resync = lex(start, begin + text.size(), delta, first, pending);
+        _stats.relexed_bytes = (pending.empty() ? start : pending.back().end) - start;
+
+        // a document lexed whole is labelled whole
+        if (first == 0 && resync == _spans.size()) _spacing = max_spacing / (pending.size() + 1);
+        uint64_t low = first ? _spans[first - 1].label : 0;
+        uint64_t high = resync < _spans.size() ? _spans[resync].label : ~uint64_t(0);
+        uint64_t step = resync < _spans.size() ? (high - low) / (pending.size() + 1) : _spacing;
+        bool relabel = step == 0 || (resync == _spans.size() && (high - low) / (pending.size() + 1) < step);
+
+        // the declarations the edit removed or added, the units after it that name one of them are parsed again
+        std::unordered_map<std::string, int64_t> declared;
+        for (size_t i = first; i < resync; i++) {
+            forget(*_units[i], _spans[i].label);
+            for (const std::string& name : _units[i]->declared) declared[name]--;
+        }
+        std::vector<std::unique_ptr<unit_t>> units;
+        for (size_t i = 0; i < pending.size(); i++) {
+            units.push_back(make_unit(pending[i]));
+            uint64_t label = low + step * (i + 1);
+            remember(*units.back(), label);
+            for (const std::string& name : units.back()->declared) declared[name]++;
+        }
+        std::vector<uint64_t> dependents;
+        for (const auto& [name, count] : declared) {
+            if (count == 0) continue;
+            auto it = _uses.find(name);
+            if (it == _uses.end()) continue;
+            for (auto use = it->second.lower_bound(high); use != it->second.end(); use++) dependents.push_back(*use);
+        }
+        std::sort(dependents.begin(), dependents.end());
+        dependents.erase(std::unique(dependents.begin(), dependents.end()), dependents.end());
+
+        splice(first, resync, pending, units, low, step, delta);
+        std::vector<size_t> dependent_indexes;
+        for (uint64_t label : dependents) dependent_indexes.push_back(index_of(label));
+        if (relabel) this->relabel();
+
+        for (size_t i = 0; i < pending.size(); i++) parse(first + i, pending[i]);
+        for (size_t index : dependent_indexes) {
+            pending_t again = relex(_spans[index].begin, _spans[index].end);
+            parse(index, again);
+        }
+        _stats.units = _units.size();
+        _stats.reparsed = pending.size() + dependent_indexes.size();
+    }
+
+    const std::string& text() const {
+        return _text;
+    }
+
+    // of every unit, in the order of the document
+    std::vector<diagnostic_t> diagnostics() const {
+        std::vector<diagnostic_t> diagnostics;
+        for (uint64_t label : _failing) {
+            size_t index = index_of(label);
+            for (const diagnostic_t& diagnostic : _units[index]->diagnostics) {
+                diagnostics.push_back({ _spans[index].begin + diagnostic.offset, diagnostic.length, diagnostic.message });
+            }
+        }
+        return diagnostics;
+    }
+
+    // positions as editors give them, a line and the utf-16 code units before the position in the line
+    uint64_t offset(uint64_t line, uint64_t character) const {
+        if (line >= _lines.size()) return _text.size();
+        uint64_t offset = _lines[line];
+        uint64_t line_end = line + 1 < _lines.size() ? _lines[line + 1] - 1 : _text.size();
+        for (uint64_t units = 0; offset < line_end && units < character;) {
+            uint8_t c = _text[offset];
+            units += c >= 0xf0 ? 2 : 1;
+            offset += c >= 0xf0 ? 4 : c >= 0xe0 ? 3 : c >= 0xc0 ? 2 : 1;
+        }
+        return std::min(offset, line_end);
+    }
+
+    std::pair<uint64_t, uint64_t> position(uint64_t offset) const {
+        offset = std::min<uint64_t>(offset, _text.size());
+        uint64_t line = std::upper_bound(_lines.begin(), _lines.end(), offset) - _lines.begin() - 1;
+        uint64_t character = 0;
+        for (uint64_t i = _lines[line]; i < offset; i++) {
+            uint8_t c = _text[i];
+            // continuation bytes add nothing, code points past the basic plane are two units
+            if ((c & 0xc0) != 0x80) character += c >= 0xf0 ? 2 : 1;
+        }
+        return { line, character };
+    }
+
+    const document_stats_t& stats() const {
+        return _stats;
+    }
+
+private:
+    // the bytes of every unit, in an array of their own since every edit moves the ones after it
+    struct span_t {
+        uint64_t begin;
+        uint64_t end;
+        uint64_t label;  // increases along the document, a unit sees the declarations of units with smaller ones
+    };
+
+    struct unit_t {
+        bool terminated{ false };             // ends with ; or } outside of braces, only the last unit may not
+        std::vector<std::string> names;       // every identifier in it, once
+        std::vector<std::string> declared;    // after int, in order, also when the unit does not parse
+        std::vector<diagnostic_t> diagnostics;  // offsets from the begin of the unit
+    };
+
+    // a unit lexed but not yet parsed, its tokens are [tokens_begin, tokens_end) of _tokens
+    struct pending_t {
+        uint64_t begin{ 0 };
+        uint64_t end{ 0 };
+        size_t tokens_begin{ 0 };
+        size_t tokens_end{ 0 };
+        bool terminated{ false };
+        std::vector<diagnostic_t> errors;  // of the lexer, absolute offsets
+    };
+
+    static constexpr uint64_t max_spacing = uint64_t(1) << 62;
+
+    // from start, splits the tokens into units, returns the index of the first old unit that stays
+    size_t lex(uint64_t start, uint64_t suffix, int64_t delta, size_t first, std::vector<pending_t>& pending) {
+        lexer_t lexer{ _text, _engine };
+        lexer.seek(start);
+        _tokens.clear();
+        pending_t unit;
+        bool open = false;
+        size_t depth = 0;
+        auto close = [&](bool terminated) {
+            unit.tokens_end = _tokens.size();
+            unit.terminated = terminated;
+            pending.push_back(std::move(unit));
+            unit = {};
+            open = false;
+        };
+        while (true) {
+            token_t token = lexer.next_tolerant();
+            if (token.type == token_type_t::e_end) break;
+            if (!open) {
+                unit.begin = token.offset;
+                unit.tokens_begin = _tokens.size();
+                open = true;
+            }
+            unit.end = token.offset + token.length;
+            if (token.type == token_type_t::e_undefined) {
+                unit.errors.push_back({ token.offset, 1, std::string("unexpected char ") + _text[token.offset] });
+                continue;
+            }
+            _tokens.push_back(token);
+            if (token.type == token_type_t::e_lbrace) depth++;
+            if (token.type != token_type_t::e_rbrace && token.type != token_type_t::e_semicolon) continue;
+            if (token.type == token_type_t::e_rbrace && depth) depth--;
+            if (depth) continue;
+            uint64_t end = unit.end;
+            close(true);
+
+            if (end < suffix) continue;
+            uint64_t old_end = end - delta;
+            auto it = std::lower_bound(_spans.begin() + first, _spans.end(), old_end, [](const span_t& span, uint64_t position) { return span.end < position; });
+            if (it != _spans.end() && it->end == old_end && _units[it - _spans.begin()]->terminated) return it - _spans.begin() + 1;
+        }
+        if (open) close(false);
+        return _spans.size();
+    }
+
+    // the tokens of one unit again, for parsing a unit the edit did not touch
+    pending_t relex(uint64_t begin, uint64_t end) {
+        lexer_t lexer{ _text, _engine };
+        lexer.seek(begin);
+        _tokens.clear();
+        pending_t unit;
+        unit.begin = begin;
+        unit.end = end;
+        while (true) {
+            token_t token = lexer.next_tolerant();
+            if (token.type == token_type_t::e_end || token.offset >= end) break;
+            if (token.type == token_type_t::e_undefined) {
+                unit.errors.push_back({ token.offset, 1, std::string("unexpected char ") + _text[token.offset] });
+                continue;
+            }
+            _tokens.push_back(token);
+        }
+        unit.tokens_end = _tokens.size();
+        return unit;
+    }
+
+    std::unique_ptr<unit_t> make_unit(const pending_t& pending) const {
+        auto unit = std::make_unique<unit_t>();
+        unit->terminated = pending.terminated;
+        for (size_t token = pending.tokens_begin; token < pending.tokens_end; token++) {
+            if (_tokens.types[token] != token_type_t::e_identifier) continue;
+            std::string name = _text.substr(_tokens.offsets[token], _tokens.lengths[token]);
+            if (token > pending.tokens_begin && _tokens.types[token - 1] == token_type_t::e_int) unit->declared.push_back(name);
+            unit->names.push_back(std::move(name));
+        }
+        std::sort(unit->names.begin(), unit->names.end());
+        unit->names.erase(std::unique(unit->names.begin(), unit->names.end()), unit->names.end());
+        return unit;
+    }
+
+    void remember(const unit_t& unit, uint64_t label) {
+        for (const std::string& name : unit.declared) _declarations[name].insert(label);
+        for (const std::string& name : unit.names) _uses[name].insert(label);
+        if (!unit.diagnostics.empty()) _failing.insert(label);
+    }
+
+    void forget(const unit_t& unit, uint64_t label) {
+        for (const std::string& name : unit.declared) erase(_declarations, name, label);
+        for (const std::string& name : unit.names) erase(_uses, name, label);
+        _failing.erase(label);
+    }
+
+    static void erase(std::unordered_map<std::string, std::multiset<uint64_t>>& labels, const std::string& name, uint64_t label) {
+        auto it = labels.find(name);
+        if (it == labels.end()) return;
+        if (auto position = it->second.find(label); position != it->second.end()) it->second.erase(position);
+        if (it->second.empty()) labels.erase(it);
+    }
+
+    // puts the new units in place of [first, resync), only the spans of the units after them move
+    void splice(size_t first, size_t resync, const std::vector<pending_t>& pending, std::vector<std::unique_ptr<unit_t>>& units,
+                uint64_t low, uint64_t step, int64_t delta) {
+        for (size_t i = resync; i < _spans.size(); i++) {
+            _spans[i].begin += delta;
+            _spans[i].end += delta;
+        }
+        size_t replaced = resync - first;
+        size_t kept = std::min(replaced, units.size());
+        for (size_t i = 0; i < kept; i++) {
+            _spans[first + i] = { pending[i].begin, pending[i].end, low + step * (i + 1) };
+            _units[first + i] = std::move(units[i]);
+        }
+        if (replaced > kept) {
+            _spans.erase(_spans.begin() + first + kept, _spans.begin() + resync);
+            _units.erase(_units.begin() + first + kept, _units.begin() + resync);
+        } else {
+            std::vector<span_t> spans;
+            for (size_t i = kept; i < units.size(); i++) spans.push_back({ pending[i].begin, pending[i].end, low + step * (i + 1) });
+            _spans.insert(_spans.begin() + first + kept, spans.begin(), spans.end());
+            _units.insert(_units.begin() + first + kept, std::make_move_iterator(units.begin() + kept), std::make_move_iterator(units.end()));
+        }
+    }
+
+    // spreads the labels evenly again once the gap an edit falls into is used up
+    void relabel() {
+        _spacing = max_spacing / (_spans.size() + 1);
+        _declarations.clear();
+        _uses.clear();
+        _failing.clear();
+        for (size_t i = 0; i < _spans.size(); i++) {
+            _spans[i].label = _spacing * (i + 1);
+            remember(*_units[i], _spans[i].label);
+        }
+    }
+
+    size_t index_of(uint64_t label) const {
+        return std::lower_bound(_spans.begin(), _spans.end(), label, [](const span_t& span, uint64_t label) { return span.label < label; }) - _spans.begin();
+    }
+
+    // the variables declared by the units before it are predeclared, so it is parsed as part of the document
+    void parse(size_t index, const pending_t& pending) {
+        unit_t& unit = *_units[index];
+        uint64_t label = _spans[index].label;
+        bool failing = !unit.diagnostics.empty();
+        unit.diagnostics.clear();
+        for (const diagnostic_t& error : pending.errors) unit.diagnostics.push_back({ error.offset - pending.begin, error.length, error.message });
+
+        // a unit with characters the lexer does not know is not parsed, its tokens miss those
+        if (unit.diagnostics.empty() && pending.tokens_begin < pending.tokens_end) {
+            parser_t parser{ _tokens, _text, pending.tokens_begin, pending.tokens_end };
+            parser.reuse(std::move(_scratch_ast), std::move(_scratch_symbols));
+            for (size_t token = pending.tokens_begin; token < pending.tokens_end; token++) {
+                if (_tokens.types[token] != token_type_t::e_identifier) continue;
+                auto it = _declarations.find(_text.substr(_tokens.offsets[token], _tokens.lengths[token]));
+                if (it != _declarations.end() && *it->second.begin() < label) parser.predeclare(it->first);
+            }
+            auto result = parser.parse();
+            if (result) {
+                auto [ast, symbols] = result.take();
+                _scratch_ast = std::move(ast);
+                _scratch_symbols = std::move(symbols);
+            } else {
+                unit.diagnostics.push_back(locate(result.unwrapErr(), pending));
+            }
+        }
+
+        if (failing && unit.diagnostics.empty()) _failing.erase(label);
+        if (!unit.diagnostics.empty()) _failing.insert(label);
+    }
+
+    // the error on the token it points at, errors past the end of the unit point at its last token
+    diagnostic_t locate(const error_t& error, const pending_t& pending) const {
+        size_t token = pending.tokens_end - 1;
+        for (size_t i = pending.tokens_begin; i < pending.tokens_end; i++) {
+            if (_tokens.offsets[i] >= error.offset) {
+                token = i;
+                break;
+            }
+        }
+        return { _tokens.offsets[token] - pending.begin, _tokens.lengths[token], std::string(error.what()) };
+    }
+
+    // line starts after replacing [begin, end) with text
+    void update_lines(uint64_t begin, uint64_t end, std::string_view text) {
+        if (_lines.empty()) _lines.push_back(0);
+        auto first = std::upper_bound(_lines.begin(), _lines.end(), begin);
+        auto last = std::upper_bound(first, _lines.end(), end);
+        int64_t delta = int64_t(text.size()) - int64_t(end - begin);
+        for (auto it = last; it != _lines.end(); it++) *it += delta;
+        std::vector<uint64_t> lines;
+        for (size_t i = 0; i < text.size(); i++) {
+            if (text[i] == '\n') lines.push_back(begin + i + 1);
+        }
+        size_t at = first - _lines.begin();
+        _lines.erase(first, last);
+        _lines.insert(_lines.begin() + at, lines.begin(), lines.end());
+    }
+
+private:
+    lexer_engine_t _engine;
+    std::string _text;
+    std::vector<uint64_t> _lines{ 0 };  // offset of every line start
+    std::vector<span_t> _spans;
+    std::vector<std::unique_ptr<unit_t>> _units;  // along _spans
+    uint64_t _spacing{ max_spacing };  // between the labels of units added at the end
+
+    // by name, the labels of the units declaring it and of the units naming it
+    std::unordered_map<std::string, std::multiset<uint64_t>> _declarations;
+    std::unordered_map<std::string, std::multiset<uint64_t>> _uses;
+    std::set<uint64_t> _failing;  // labels of the units with diagnostics
+
+    // warm buffers for lexing and parsing the units
+    token_buffer_t _tokens;
+    ast_t _scratch_ast;
+    symbol_table_t _scratch_symbols;
+
+    document_stats_t _stats;
+};
+
+} // namespace sl
+
+#endif
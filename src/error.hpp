@@ -0,0 +1,103 @@
+#ifndef ERROR_HPP
+#define ERROR_HPP
+
+#include <algorithm>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <type_traits>
+
+namespace sl {
+
+enum class error_code_t : uint8_t {
+    e_none,
+    e_expected_identifier,
+    e_redeclared,
+    e_unexpected,
+    e_identifier_not_found,
+    e_expected_operand,
+    e_expected_operator,
+    e_expected_lbracket,
+    e_expected_rbracket,
+    e_expected_lbrace,
+    e_assign_to_non_identifier,
+    e_unparsable_if,
+    e_unparsable_statement,
+    e_unexpected_rbrace,
+    e_number_out_of_range,
+};
+
+// indexed by error_code_t
+inline constexpr std::string_view error_messages[] = {
+    "no error",
+    "expected an identifier",
+    "Redeclaraing variable",
+    "unexpected error",
+    "identifier not found",
+    "expected an identifier, a number or (",
+    "expected ; or an operator",
+    "Expected (",
+    "Expected )",
+    "Expected {",
+    "expected an identifier on the left of =",
+    "unparsable if",
+    "unparsable statement",
+    "unexpected }",
+    "number out of range",
+};
+
+static_assert(std::size(error_messages) == size_t(error_code_t::e_number_out_of_range) + 1);
+
+// an error code and the source offset it was found at, the message is only built when it is reported
+struct error_t {
+    error_code_t code;
+    uint64_t offset;
+
+    std::string_view what() const {
+        return error_messages[size_t(code)];
+    }
+
+    // line:column: message, with only the offset when the source is not at hand (e.g. it was streamed)
+    std::string message(std::string_view source = {}) const {
+        if (offset > source.size()) return "offset " + std::to_string(offset) + ": " + std::string(what());
+        std::string_view before = source.substr(0, offset);
+        size_t line = std::count(before.begin(), before.end(), '\n') + 1;
+        size_t line_start = before.rfind('\n');
+        size_t column = offset - (line_start == std::string_view::npos ? 0 : line_start + 1) + 1;
+        return std::to_string(line) + ":" + std::to_string(column) + ": " + std::string(what());
+    }
+};
+
+// trivially copyable result for the parser hot path, a value or an error sharing the same storage
+// small enough to come back in registers, so checking it costs about as much as a raw return code
+template <typename T>
+class result_t {
+    static_assert(std::is_trivially_copyable_v<T> && std::is_trivially_destructible_v<T>);
+
+public:
+    constexpr result_t(T value) noexcept : _value(value), _code(error_code_t::e_none) {}
+    constexpr result_t(error_t error) noexcept : _offset(error.offset), _code(error.code) {}
+
+    constexpr explicit operator bool() const noexcept {
+        return _code == error_code_t::e_none;
+    }
+
+    constexpr T value() const noexcept {
+        return _value;
+    }
+
+    constexpr error_t error() const noexcept {
+        return { _code, _offset };
+    }
+
+private:
+    union {
+        T _value;
+        uint64_t _offset;
+    };
+    error_code_t _code;
+};
+
+} // namespace sl
+
+#endif
@@ -0,0 +1,337 @@
+#ifndef INCREMENTAL_HPP
+#define INCREMENTAL_HPP
+
+// recompiles a program after an edit by redoing only the top level statements it touched
+// every top level statement is a unit with its byte range, its own small ast and the asm generated for it
+// a new version of the source is compared with the last one from both ends, only the units overlapping the
+// bytes in between are lexed and parsed again, lexing stops as soon as it is back in step with an old unit
+// the asm of a unit depends on the addresses of the variables it uses, on the number of labels and declarations
+// before it and on the number of declarations overall, so units whose statements did not change keep their asm
+// unless the edit moved one of those, which only happens when it adds or removes declarations or ifs
+
+#include "code_gen.hpp"
+#include "compiler.hpp"
+#include "lexer.hpp"
+#include "parser.hpp"
+
+#include <algorithm>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace sl {
+
+struct incremental_stats_t {
+    size_t units{ 0 };        // top level statements of the program
+    size_t reparsed{ 0 };     // lexed and parsed again by the last compile
+    size_t regenerated{ 0 };  // given new asm by the last compile, the reparsed ones and the ones whose variables moved
+    size_t lexed_bytes{ 0 };  // by the last compile
+};
+
+class incremental_compiler_t {
+public:
+    explicit incremental_compiler_t(lexer_engine_t engine = lexer_engine_t::e_hand_written) : _engine(engine) {}
+
+    // the asm of source as compile() gives it, or the error
+    // every call is compared with the last source that compiled, a source with an error leaves that one in place
+    Result<std::string, std::string> compile(std::string_view source) {
+        _stats = {};
+        bool ok = false;
+        try {
+            ok = update(source);
+        } catch (const std::runtime_error&) {
+            // the lexer throws on characters that are not part of the language and code gen on == used as a value,
+            // the latter after the units were taken, so start over on the next compile
+            reset();
+        }
+        if (ok) return Ok(output());
+
+        // the messages of the whole program compiler, the units are checked one by one and would point elsewhere
+        Result<std::string, std::string> result = sl::compile(source, { _engine, false });
+        if (result) {
+            // cannot happen unless the units and the program disagree, start over rather than keep a wrong state
+            reset();
+            update(source);
+        }
+        return result;
+    }
+
+    const incremental_stats_t& stats() const {
+        return _stats;
+    }
+
+    // forgets the last source, the next compile does all the work again
+    void reset() {
+        _source.clear();
+        _units.clear();
+        _declarations.clear();
+        _declaration_count = 0;
+    }
+
+private:
+    struct unit_t {
+        uint64_t begin;  // source bytes from the first token to one past the last
+        uint64_t end;
+        uint64_t label{ 0 };  // increases along _units, a declaration is visible to the units with a larger label
+
+        ast_t ast;  // parsed on its own, symbol ids are local to the unit
+        // by local id, the first externals are the variables declared in earlier units it reads or writes
+        // and the others the ones it declares, in order
+        std::vector<std::string> names;
+        uint32_t externals{ 0 };
+        uint32_t ifs{ 0 };  // labels its code takes
+
+        std::string code;
+        // what the code was generated for, see code_gen_t
+        uint32_t declaration_base{ 0 };  // address of its first declaration, the declarations before it
+        uint32_t section_base{ 0 };      // ifs before it
+        uint32_t temp_offset{ 0 };       // declarations in the program
+        std::vector<uint32_t> external_offsets;
+
+        uint32_t declared() const {
+            return names.size() - externals;
+        }
+    };
+
+    struct declaration_t {
+        uint64_t label;   // of the declaring unit
+        uint32_t offset;  // address of the variable
+    };
+
+    static constexpr uint64_t label_spacing = uint64_t(1) << 32;
+
+    // false on an error, which leaves the state of the last good source
+    bool update(std::string_view source) {
+        // the edit lies in between the common prefix and the common suffix of the two versions
+        size_t limit = std::min(source.size(), _source.size());
+        size_t prefix = std::mismatch(_source.begin(), _source.begin() + limit, source.begin()).first - _source.begin();
+        size_t suffix = 0;
+        while (suffix < limit - prefix && _source[_source.size() - 1 - suffix] == source[source.size() - 1 - suffix]) suffix++;
+        int64_t delta = int64_t(source.size()) - int64_t(_source.size());
+
+        // units ending at or before the prefix end with ; or } and are followed by the same bytes, so they stay
+        size_t first = std::upper_bound(_units.begin(), _units.end(), prefix, [](size_t position, const auto& unit) { return position < unit->end; }) - _units.begin();
+        uint64_t start = first ? _units[first - 1]->end : 0;
+
+        // lex from there until a unit ends where an old one ended, inside the common suffix
+        lexer_t lexer{ source, _engine };
+        lexer.seek(start);
+        _tokens.clear();
+        std::vector<size_t> bounds{ 0 };  // of the new units in _tokens
+        size_t resync = _units.size();    // the first old unit kept after the new ones
+        size_t depth = 0;
+        while (true) {
+            token_t token = lexer.next();
+            if (token.type == token_type_t::e_end) break;
+            if (token.type == token_type_t::e_undefined) return false;
+            _tokens.push_back(token);
+            if (token.type == token_type_t::e_lbrace) {
+                depth++;
+                continue;
+            }
+            if (token.type != token_type_t::e_rbrace && token.type != token_type_t::e_semicolon) continue;
+            if (token.type == token_type_t::e_rbrace && depth) depth--;
+            if (depth) continue;
+            bounds.push_back(_tokens.size());
+
+            uint64_t end = token.offset + token.length;
+            if (end < source.size() - suffix) continue;
+            uint64_t old_end = end - delta;
+            auto it = std::lower_bound(_units.begin() + (first ? first - 1 : 0), _units.end(), old_end, [](const auto& unit, uint64_t position) { return unit->end < position; });
+            if (it != _units.end() && (*it)->end == old_end) {
+                resync = it - _units.begin() + 1;
+                break;
+            }
+        }
+        // an unfinished statement at the end is parsed to give its error
+        if (bounds.back() != _tokens.size()) bounds.push_back(_tokens.size());
+        _stats.lexed_bytes = (_tokens.size() ? _tokens.offsets.back() + _tokens.lengths.back() : start) - start;
+
+        uint64_t low = first ? _units[first - 1]->label : 0;
+        uint64_t high = resync < _units.size() ? _units[resync]->label : ~uint64_t(0);
+        std::vector<std::unique_ptr<unit_t>> units;
+        if (!parse_units(source, bounds, low, units)) return false;
+        // spread over the gap the old units leave, all are given new labels once the gap is used up
+        uint64_t step = resync < _units.size() ? (high - low) / (units.size() + 1) : label_spacing;
+        bool relabel = step == 0;
+        for (size_t i = 0; i < units.size(); i++) units[i]->label = low + step * (i + 1);
+
+        // the addresses and labels before and after the edit stay where they were unless it changed the
+        // sequence of declarations or the number of ifs
+        std::vector<std::string_view> old_declared;
+        std::vector<std::string_view> new_declared;
+        uint32_t old_ifs = 0;
+        uint32_t new_ifs = 0;
+        for (size_t i = first; i < resync; i++) {
+            for (uint32_t id = _units[i]->externals; id < _units[i]->names.size(); id++) old_declared.push_back(_units[i]->names[id]);
+            old_ifs += _units[i]->ifs;
+        }
+        for (const auto& unit : units) {
+            for (uint32_t id = unit->externals; id < unit->names.size(); id++) new_declared.push_back(unit->names[id]);
+            new_ifs += unit->ifs;
+        }
+        bool moved = old_declared != new_declared || old_ifs != new_ifs;
+
+        for (std::string_view name : old_declared) _declarations.erase(std::string(name));
+        for (const auto& unit : units) {
+            for (uint32_t id = unit->externals; id < unit->names.size(); id++) {
+                // declared again by a unit after the edit
+                if (!_declarations.emplace(unit->names[id], declaration_t{ unit->label, 0 }).second) return restore();
+            }
+        }
+        if (moved) {
+            for (size_t i = resync; i < _units.size(); i++) {
+                if (!still_valid(*_units[i])) return restore();
+            }
+        }
+
+        // the source compiles, take it
+        for (size_t i = resync; i < _units.size(); i++) {
+            _units[i]->begin += delta;
+            _units[i]->end += delta;
+        }
+        _units.erase(_units.begin() + first, _units.begin() + resync);
+        _units.insert(_units.begin() + first, std::make_move_iterator(units.begin()), std::make_move_iterator(units.end()));
+        _source.assign(source);
+        if (relabel) {
+            for (size_t i = 0; i < _units.size(); i++) {
+                _units[i]->label = label_spacing * (i + 1);
+                for (uint32_t id = _units[i]->externals; id < _units[i]->names.size(); id++) _declarations[_units[i]->names[id]].label = _units[i]->label;
+            }
+        }
+
+        // new units continue the addresses and labels of the one before them
+        uint32_t declaration_base = 0;
+        uint32_t section_base = 0;
+        if (first) {
+            declaration_base = _units[first - 1]->declaration_base + _units[first - 1]->declared();
+            section_base = _units[first - 1]->section_base + _units[first - 1]->ifs;
+        }
+        _declaration_count += new_declared.size() - old_declared.size();
+        size_t end = moved ? _units.size() : first + units.size();
+        for (size_t i = first; i < end; i++) {
+            unit_t& unit = *_units[i];
+            bool reparsed = i < first + units.size();
+            for (uint32_t id = unit.externals; id < unit.names.size(); id++) {
+                _declarations[unit.names[id]].offset = declaration_base + id - unit.externals;
+            }
+            generate(unit, declaration_base, section_base, reparsed);
+            declaration_base += unit.declared();
+            section_base += unit.ifs;
+        }
+        if (moved) {
+            // the number of declarations is where the temporaries start, units before the edit may use them
+            for (size_t i = 0; i < first; i++) generate(*_units[i], _units[i]->declaration_base, _units[i]->section_base, false);
+        }
+        _stats.units = _units.size();
+        _stats.reparsed = units.size();
+        return true;
+    }
+
+    // the units between bounds, each parsed on its own with the variables declared before it predeclared
+    bool parse_units(std::string_view source, const std::vector<size_t>& bounds, uint64_t low, std::vector<std::unique_ptr<unit_t>>& units) {
+        std::unordered_set<std::string_view> declared_here;  // by the units parsed so far, views of their names
+        for (size_t i = 0; i + 1 < bounds.size(); i++) {
+            parser_t parser{ _tokens, source, bounds[i], bounds[i + 1] };
+            parser.reuse(std::move(_scratch_ast), std::move(_scratch_symbols));
+
+            // every identifier declared before the unit, those used and those declared again, which is an error
+            uint32_t externals = 0;
+            for (size_t token = bounds[i]; token < bounds[i + 1]; token++) {
+                if (_tokens.types[token] != token_type_t::e_identifier) continue;
+                std::string_view name = source.substr(_tokens.offsets[token], _tokens.lengths[token]);
+                auto it = _declarations.find(std::string(name));
+                bool before = declared_here.count(name) || (it != _declarations.end() && it->second.label <= low);
+                if (before) externals += parser.predeclare(name);
+            }
+
+            auto result = parser.parse();
+            if (!result) return false;
+            auto [ast, symbols] = result.take();
+
+            auto unit = std::make_unique<unit_t>();
+            unit->begin = _tokens.offsets[bounds[i]];
+            unit->end = _tokens.offsets[bounds[i + 1] - 1] + _tokens.lengths[bounds[i + 1] - 1];
+            unit->ast.statements = ast.statements;
+            unit->ast.expressions = ast.expressions;
+            unit->externals = externals;
+            for (uint32_t id = 0; id < symbols.size(); id++) unit->names.emplace_back(symbols.name(id));
+            for (const statement_t& statement : ast.statements) unit->ifs += statement.type == statement_type_t::e_if;
+            for (uint32_t id = unit->externals; id < unit->names.size(); id++) declared_here.insert(unit->names[id]);
+            units.push_back(std::move(unit));
+
+            _scratch_ast = std::move(ast);
+            _scratch_symbols = std::move(symbols);
+        }
+        return true;
+    }
+
+    // after the edit changed the declarations, every variable a unit after it uses must still be declared before it
+    bool still_valid(const unit_t& unit) const {
+        for (uint32_t id = 0; id < unit.externals; id++) {
+            auto it = _declarations.find(unit.names[id]);
+            if (it == _declarations.end() || it->second.label >= unit.label) return false;
+        }
+        return true;
+    }
+
+    // undoes the changes to _declarations of an update that failed
+    bool restore() {
+        _declarations.clear();
+        uint32_t offset = 0;
+        for (const auto& unit : _units) {
+            for (uint32_t id = unit->externals; id < unit->names.size(); id++) _declarations[unit->names[id]] = { unit->label, offset++ };
+        }
+        return false;
+    }
+
+    // the code of unit for where it is now, kept when nothing it depends on moved
+    void generate(unit_t& unit, uint32_t declaration_base, uint32_t section_base, bool force) {
+        std::vector<uint32_t> offsets(unit.names.size(), code_gen_t::no_offset);
+        for (uint32_t id = 0; id < unit.externals; id++) offsets[id] = _declarations[unit.names[id]].offset;
+        bool same = !force && unit.declaration_base == declaration_base && unit.section_base == section_base &&
+                    unit.temp_offset == _declaration_count && std::equal(offsets.begin(), offsets.begin() + unit.externals, unit.external_offsets.begin(), unit.external_offsets.end());
+        if (same) return;
+
+        code_gen_t code_gen{ unit.ast, offsets, declaration_base, _declaration_count, section_base };
+        unit.code = code_gen.gen_statements();
+        unit.declaration_base = declaration_base;
+        unit.section_base = section_base;
+        unit.temp_offset = _declaration_count;
+        unit.external_offsets.assign(offsets.begin(), offsets.begin() + unit.externals);
+        _stats.regenerated++;
+    }
+
+    std::string output() const {
+        size_t size = code_gen_t::header.size() + code_gen_t::footer.size() + 1;
+        for (const auto& unit : _units) size += unit->code.size();
+        std::string output;
+        output.reserve(size);
+        output += code_gen_t::header;
+        for (const auto& unit : _units) output += unit->code;
+        output += code_gen_t::footer;
+        output += '\n';
+        return output;
+    }
+
+private:
+    lexer_engine_t _engine;
+    std::string _source;  // the last one that compiled
+    std::vector<std::unique_ptr<unit_t>> _units;  // pointers, an edit moves the units after it
+    std::unordered_map<std::string, declaration_t> _declarations;  // every variable of the program
+    uint32_t _declaration_count{ 0 };
+
+    // warm buffers for lexing and parsing the units
+    token_buffer_t _tokens;
+    ast_t _scratch_ast;
+    symbol_table_t _scratch_symbols;
+
+    incremental_stats_t _stats;
+};
+
+} // namespace sl
+
+#endif
@@ -5,106 +5,112 @@
 
 #include "parser.hpp"
 
-#include <map>
-#include <stack>
+#include <algorithm>
+#include <sstream>
 
 namespace sl {
 
+// var: name = value lines for the live variables, sorted by name, what every engine's get_state gives
+inline std::string format_state(names_view_t names, const uint8_t *values, const std::vector<bool>& live) {
+    std::vector<uint32_t> ids;
+    for (uint32_t id = 0; id < live.size(); id++) {
+        if (live[id]) ids.push_back(id);
+    }
+    std::sort(ids.begin(), ids.end(), [&](uint32_t a, uint32_t b) { return names.name(a) < names.name(b); });
+    std::stringstream s;
+    for (uint32_t id : ids) {
+        s << "var: " << names.name(id) << " = " << uint32_t(values[id]) << '\n';
+    }
+    return s.str();
+}
+
+// walks the flat ast with a statement index, an if whose condition is false jumps past its body
 class interpreter_t {
 public:
-    interpreter_t(const ast_t& ast, const std::vector<std::string>& identifier_table) : _ast(ast), _identifier_table(identifier_table) {
-        for (int32_t i = _ast.statements.size() - 1; i >= 0; i--) {
-            statement_t *statement = _ast.statements[i];
-            stack.push(statement);
-        }
-    }
+    interpreter_t(ast_view_t ast, names_view_t symbols) : _ast(ast), _symbols(symbols), _variables(symbols.size()), _live(symbols.size()) {}
 
     bool can_run() {
-        return stack.size();
+        return _next < _ast.statements.size();
     }
 
     void run_statement() {
-        statement_t *statement = stack.top(); stack.pop();
-        switch (statement->type) {
+        const statement_t& statement = _ast.statements[_next];
+        switch (statement.type) {
             case statement_type_t::e_declaration:
-                run_declaration(statement->as.declaration);
+                run_declaration(statement);
                 break;
             case statement_type_t::e_expression:
-                run_expression(statement->as.expression);
+                run_expression(statement.expression);
                 break;
             case statement_type_t::e_if:
-                run_if(statement->as._if);
-                break;
+                run_if(statement);
+                return;
         }
+        _next++;
     }
 
     std::string get_state() {
-        std::stringstream s;
-        for (auto [var, val] : _variables) {
-            s << "var: " << var << " = " << uint32_t(val) << '\n';
-        }
-        return s.str();
+        return format_state(_symbols, _variables.data(), _live);
     }
 
 private:
-    void run_declaration(declaration_t *declaration) {
-        switch(declaration->type) {
-            case declaration_type_t::e_simple:
-                _variables[_identifier_table[declaration->as.simple.identifier->id]] = 0;
-                break;
-            case declaration_type_t::e_complex:
-                _variables[_identifier_table[declaration->as.complex.identifier->id]] = run_expression(declaration->as.complex.expression);
-                break;
+    uint8_t& variable(uint32_t id) {
+        _live[id] = true;
+        return _variables[id];
+    }
+
+    void run_declaration(const statement_t& declaration) {
+        if (declaration.expression == ast_t::npos) {
+            variable(declaration.id) = 0;
+        } else {
+            variable(declaration.id) = run_expression(declaration.expression);
         }
     }
 
-    uint8_t run_expression(expression_t *expression) {
-        if (expression->type == expression_type_t::e_unary) {
-            if (expression->as.unary.type == unary_type_t::e_number) {
-                return expression->as.unary.as.number->number;
-            } else {
-                return _variables[_identifier_table[expression->as.unary.as.identifier->id]];
-            }
-        } 
-
-        uint8_t acc = run_expression(expression->as.binary.right_expression);
-
-        switch (expression->as.binary.op->type) {
-            case token_type_t::e_assign:
-                if (expression->as.binary.left_expression->type != expression_type_t::e_unary) throw std::runtime_error("unexpected error");
-                _variables[_identifier_table[expression->as.binary.left_expression->as.unary.as.identifier->id]] = acc;
+    uint8_t run_expression(uint32_t index) {
+        const expression_t& expression = _ast.expressions[index];
+        switch (expression.type) {
+            case expression_type_t::e_number:
+                return expression.as.number;
+            case expression_type_t::e_identifier:
+                return variable(expression.as.id);
+            case expression_type_t::e_binary:
+                break;
+        }
+
+        uint8_t acc = run_expression(expression.as.binary.right);
+
+        switch (expression.op) {
+            case op_t::e_assign:
+                variable(_ast.expressions[expression.as.binary.left].as.id) = acc;
                 break;
-            case token_type_t::e_plus:
-                acc = run_expression(expression->as.binary.left_expression) + acc;
+            case op_t::e_plus:
+                acc = run_expression(expression.as.binary.left) + acc;
                 break;
-            case token_type_t::e_minus:
-                acc = run_expression(expression->as.binary.left_expression) - acc;
+            case op_t::e_minus:
+                acc = run_expression(expression.as.binary.left) - acc;
                 break;
-            case token_type_t::e_equal:
-                acc = run_expression(expression->as.binary.left_expression) == acc;
+            case op_t::e_equal:
+                acc = run_expression(expression.as.binary.left) == acc;
                 break;
         }
         return acc;
     }
 
-    void run_if(if_t *_if) {
-        uint8_t acc = run_expression(_if->expression);
-
-        if (acc) {
-            for (int i = _if->truthy.size() - 1; i >= 0; i--) {
-                statement_t *statement = _if->truthy[i];
-                stack.push(statement);
-            }
-        }
+    void run_if(const statement_t& _if) {
+        uint8_t acc = run_expression(_if.expression);
+        _next = acc ? _next + 1 : _if.end;
     }
 
 private:
-    ast_t _ast;
-    std::vector<std::string> _identifier_table;
+    ast_view_t _ast;  // the ast and the names it views must outlive this
+    names_view_t _symbols;
 
-    std::map<std::string, uint8_t> _variables; 
+    // indexed by symbol id, live marks the variables that were touched, those are the ones get_state reports
+    std::vector<uint8_t> _variables;
+    std::vector<bool> _live;
 
-    std::stack<statement_t *> stack;
+    uint32_t _next{ 0 };  // index of the next statement to run
 };
 
 } // namespace sl
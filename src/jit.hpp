@@ -0,0 +1,203 @@
+#ifndef JIT_HPP
+#define JIT_HPP
+
+// translates bytecode to x86-64 machine code, for programs that are run many times
+// the registers stay a flat byte array the code reads and writes in place, every operation is done on al so it
+// wraps at 8 bits like the other engines, and a taken jump sets its byte in taken before jumping, as bytecode_vm_t
+// does, so get_state is the same; the code is written to an mmap'd region that is made executable once it is done
+// where that is not available, not x86-64 or the kernel refuses executable pages, the bytecode vm runs instead
+
+#include "bytecode.hpp"
+
+#include <cstring>
+#include <limits>
+#include <string>
+#include <vector>
+
+#if defined(__x86_64__) && (defined(__unix__) || defined(__APPLE__))
+#include <sys/mman.h>
+#include <unistd.h>
+#define SL_HAS_JIT 1
+#endif
+
+namespace sl {
+
+class jit_t {
+public:
+    jit_t(const bytecode_t& bytecode, names_view_t symbols)
+      : _bytecode(bytecode), _symbols(symbols), _vm(bytecode, symbols), _registers(bytecode.registers), _taken(bytecode.jumps) {
+#ifdef SL_HAS_JIT
+        // the operands are addressed with 32 bit displacements and the jumps are relative by 32 bits as well
+        constexpr uint32_t max_displacement = std::numeric_limits<int32_t>::max();
+        if (bytecode.registers <= max_displacement && bytecode.jumps <= max_displacement && bytecode.code.size() <= max_displacement / max_instruction_size) {
+            assemble();
+        }
+#endif
+    }
+
+    jit_t(const jit_t&) = delete;
+    jit_t& operator=(const jit_t&) = delete;
+
+    ~jit_t() {
+#ifdef SL_HAS_JIT
+        if (_code) ::munmap(_code, _size);
+#endif
+    }
+
+    // whether run executes machine code, or falls back to the bytecode vm
+    bool compiled() const {
+        return _code != nullptr;
+    }
+
+    // runs from the start to the end, the registers start at 0 on every run
+    void run() {
+        if (!_code) {
+            _vm.run();
+            return;
+        }
+        std::fill(_registers.begin(), _registers.end(), 0);
+        std::fill(_taken.begin(), _taken.end(), 0);
+        reinterpret_cast<entry_t>(_code)(_registers.data(), _taken.data());
+    }
+
+    std::string get_state() const {
+        if (!_code) return _vm.get_state();
+        return bytecode_state(_bytecode, _symbols, _registers.data(), _taken.data());
+    }
+
+private:
+    // void (uint8_t *registers, uint8_t *taken), in rdi and rsi by the system v abi
+    using entry_t = void (*)(uint8_t *, uint8_t *);
+
+    static constexpr uint32_t max_instruction_size = 24;  // of the machine code for one bytecode instruction
+
+#ifdef SL_HAS_JIT
+    // writes the code into a mapping large enough for any code, then gives the rest back and makes it executable
+    void assemble() {
+        size_t page = ::sysconf(_SC_PAGESIZE);
+        size_t capacity = (_bytecode.code.size() * max_instruction_size + page - 1) / page * page;
+        void *memory = ::mmap(nullptr, capacity, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (memory == MAP_FAILED) return;
+        uint8_t *out = static_cast<uint8_t *>(memory);
+        std::vector<uint32_t> offsets(_bytecode.code.size());  // of each instruction in out
+        std::vector<std::pair<uint32_t, uint32_t>> fixups;     // rel32 at out offset, to instruction
+        uint8_t *p = out;
+
+        auto byte = [&](uint8_t value) { *p++ = value; };
+        auto imm32 = [&](uint32_t value) {
+            std::memcpy(p, &value, 4);
+            p += 4;
+        };
+        // op with al and byte [rdi + index], the mod r/m byte is mod 10 (disp32), reg al, rm rdi
+        auto registers = [&](uint8_t op, uint32_t index) {
+            byte(op);
+            byte(0x87);
+            imm32(index);
+        };
+        auto load = [&](uint32_t index) {  // movzx eax, byte [rdi + index]
+            byte(0x0f);
+            registers(0xb6, index);
+        };
+        auto store = [&](uint32_t index) { registers(0x88, index); };  // mov byte [rdi + index], al
+
+        for (uint32_t pc = 0; pc < _bytecode.code.size(); pc++) {
+            const instruction_t& i = _bytecode.code[pc];
+            offsets[pc] = p - out;
+            switch (i.op) {
+                case opcode_t::e_load:  // mov byte [rdi + a], imm8
+                    registers(0xc6, i.a);
+                    byte(uint8_t(i.b));
+                    break;
+                case opcode_t::e_move:
+                    load(i.b);
+                    store(i.a);
+                    break;
+                case opcode_t::e_add:  // add al, byte [rdi + c]
+                    load(i.b);
+                    registers(0x02, i.c);
+                    store(i.a);
+                    break;
+                case opcode_t::e_add_constant:  // add al, imm8
+                    load(i.b);
+                    byte(0x04);
+                    byte(uint8_t(i.c));
+                    store(i.a);
+                    break;
+                case opcode_t::e_sub:  // sub al, byte [rdi + c]
+                    load(i.b);
+                    registers(0x2a, i.c);
+                    store(i.a);
+                    break;
+                case opcode_t::e_sub_constant:  // sub al, imm8
+                    load(i.b);
+                    byte(0x2c);
+                    byte(uint8_t(i.c));
+                    store(i.a);
+                    break;
+                case opcode_t::e_sub_from_constant:  // mov al, imm8; sub al, byte [rdi + b]
+                    byte(0xb0);
+                    byte(uint8_t(i.c));
+                    registers(0x2a, i.b);
+                    store(i.a);
+                    break;
+                case opcode_t::e_equal:  // cmp al, byte [rdi + c]; sete al
+                    load(i.b);
+                    registers(0x3a, i.c);
+                    byte(0x0f), byte(0x94), byte(0xc0);
+                    store(i.a);
+                    break;
+                case opcode_t::e_equal_constant:  // cmp al, imm8; sete al
+                    load(i.b);
+                    byte(0x3c);
+                    byte(uint8_t(i.c));
+                    byte(0x0f), byte(0x94), byte(0xc0);
+                    store(i.a);
+                    break;
+                case opcode_t::e_jump_if_zero:
+                    // cmp byte [rdi + a], 0; jne over the next two (12 bytes); mov byte [rsi + c], 1; jmp b
+                    byte(0x80), byte(0xbf);
+                    imm32(i.a);
+                    byte(0x00);
+                    byte(0x75), byte(12);
+                    byte(0xc6), byte(0x86);
+                    imm32(i.c);
+                    byte(0x01);
+                    byte(0xe9);
+                    fixups.emplace_back(p - out, i.b);
+                    imm32(0);
+                    break;
+                case opcode_t::e_halt:
+                    byte(0xc3);  // ret
+                    break;
+            }
+        }
+        for (auto [at, target] : fixups) {
+            uint32_t relative = offsets[target] - (at + 4);
+            std::memcpy(out + at, &relative, 4);
+        }
+
+        size_t size = (p - out + page - 1) / page * page;
+        if (size < capacity) ::munmap(out + size, capacity - size);
+        if (::mprotect(memory, size, PROT_READ | PROT_EXEC) != 0) {
+            ::munmap(memory, size);
+            return;
+        }
+        _code = memory;
+        _size = size;
+    }
+#endif
+
+private:
+    const bytecode_t& _bytecode;  // must outlive this
+    names_view_t _symbols;
+    bytecode_vm_t _vm;  // when there is no machine code
+
+    std::vector<uint8_t> _registers;
+    std::vector<uint8_t> _taken;
+    void *_code{ nullptr };
+    size_t _size{ 0 };
+};
+
+} // namespace sl
+
+#endif
@@ -0,0 +1,354 @@
+#ifndef JSON_HPP
+#define JSON_HPP
+
+// just enough json for the language server, values are parsed into a tree and written back compactly
+// objects keep their members in the order they were written, the ones the protocol uses are small
+
+#include <cctype>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <variant>
+#include <vector>
+
+namespace sl {
+
+class json_t {
+public:
+    using array_t = std::vector<json_t>;
+    using object_t = std::vector<std::pair<std::string, json_t>>;
+
+    json_t() = default;
+    json_t(std::nullptr_t) {}
+    json_t(bool value) : _value(value) {}
+    json_t(double value) : _value(value) {}
+    json_t(int value) : _value(double(value)) {}
+    json_t(int64_t value) : _value(double(value)) {}
+    json_t(uint64_t value) : _value(double(value)) {}
+    json_t(const char *value) : _value(std::string(value)) {}
+    json_t(std::string_view value) : _value(std::string(value)) {}
+    json_t(std::string value) : _value(std::move(value)) {}
+    json_t(array_t value) : _value(std::move(value)) {}
+    json_t(object_t value) : _value(std::move(value)) {}
+
+    bool is_null() const {
+        return std::holds_alternative<std::nullptr_t>(_value);
+    }
+
+    bool is_number() const {
+        return std::holds_alternative<double>(_value);
+    }
+
+    bool is_string() const {
+        return std::holds_alternative<std::string>(_value);
+    }
+
+    bool is_array() const {
+        return std::holds_alternative<array_t>(_value);
+    }
+
+    bool is_object() const {
+        return std::holds_alternative<object_t>(_value);
+    }
+
+    // the value, or a default when it has another type, so a message with missing fields reads as empty
+    bool boolean() const {
+        const bool *value = std::get_if<bool>(&_value);
+        return value && *value;
+    }
+
+    double number() const {
+        const double *value = std::get_if<double>(&_value);
+        return value ? *value : 0;
+    }
+
+    const std::string& string() const {
+        static const std::string empty;
+        const std::string *value = std::get_if<std::string>(&_value);
+        return value ? *value : empty;
+    }
+
+    const array_t& array() const {
+        static const array_t empty;
+        const array_t *value = std::get_if<array_t>(&_value);
+        return value ? *value : empty;
+    }
+
+    // the member called key, null when there is none or this is not an object
+    const json_t& operator[](std::string_view key) const {
+        static const json_t null;
+        if (const object_t *object = std::get_if<object_t>(&_value)) {
+            for (const auto& [name, value] : *object) {
+                if (name == key) return value;
+            }
+        }
+        return null;
+    }
+
+    bool contains(std::string_view key) const {
+        if (const object_t *object = std::get_if<object_t>(&_value)) {
+            for (const auto& member : *object) {
+                if (member.first == key) return true;
+            }
+        }
+        return false;
+    }
+
+    std::string dump() const {
+        std::string text;
+        dump(text);
+        return text;
+    }
+
+    void dump(std::string& text) const {
+        switch (_value.index()) {
+            case 0:
+                text += "null";
+                break;
+            case 1:
+                text += std::get<bool>(_value) ? "true" : "false";
+                break;
+            case 2: {
+                double value = std::get<double>(_value);
+                char digits[32];
+                // integers, which is what the protocol sends, without a fraction; the cast is only defined in range,
+                // and json has no nan or infinity, a client that sends 1e999 gets null back
+                if (!std::isfinite(value)) {
+                    text += "null";
+                    break;
+                }
+                if (value >= -0x1p63 && value < 0x1p63 && value == double(int64_t(value))) {
+                    std::snprintf(digits, sizeof(digits), "%lld", static_cast<long long>(value));
+                } else {
+                    std::snprintf(digits, sizeof(digits), "%.17g", value);
+                }
+                text += digits;
+                break;
+            }
+            case 3:
+                dump_string(std::get<std::string>(_value), text);
+                break;
+            case 4: {
+                text += '[';
+                const array_t& array = std::get<array_t>(_value);
+                for (size_t i = 0; i < array.size(); i++) {
+                    if (i) text += ',';
+                    array[i].dump(text);
+                }
+                text += ']';
+                break;
+            }
+            case 5: {
+                text += '{';
+                const object_t& object = std::get<object_t>(_value);
+                for (size_t i = 0; i < object.size(); i++) {
+                    if (i) text += ',';
+                    dump_string(object[i].first, text);
+                    text += ':';
+                    object[i].second.dump(text);
+                }
+                text += '}';
+                break;
+            }
+        }
+    }
+
+    // nullopt when text is not one json value
+    static std::optional<json_t> parse(std::string_view text) {
+        reader_t reader{ text };
+        std::optional<json_t> value = reader.value(0);
+        reader.space();
+        if (!value || reader.position != text.size()) return std::nullopt;
+        return value;
+    }
+
+private:
+    static void dump_string(std::string_view value, std::string& text) {
+        static constexpr char digits[] = "0123456789abcdef";
+        text += '"';
+        for (char c : value) {
+            switch (c) {
+                case '"': text += "\\\""; break;
+                case '\\': text += "\\\\"; break;
+                case '\n': text += "\\n"; break;
+                case '\r': text += "\\r"; break;
+                case '\t': text += "\\t"; break;
+                default:
+                    if (uint8_t(c) < 0x20) {
+                        text += "\\u00";
+                        text += digits[uint8_t(c) >> 4];
+                        text += digits[uint8_t(c) & 0xf];
+                    } else {
+                        text += c;
+                    }
+            }
+        }
+        text += '"';
+    }
+
+    struct reader_t {
+        static constexpr size_t max_depth = 128;  // deeper values are rejected rather than recursed into
+
+        std::string_view text;
+        size_t position{ 0 };
+
+        void space() {
+            while (position < text.size() && (text[position] == ' ' || text[position] == '\t' || text[position] == '\n' || text[position] == '\r')) position++;
+        }
+
+        bool literal(std::string_view word) {
+            if (text.substr(position, word.size()) != word) return false;
+            position += word.size();
+            return true;
+        }
+
+        std::optional<json_t> value(size_t depth) {
+            space();
+            if (position == text.size() || depth == max_depth) return std::nullopt;
+            char c = text[position];
+            if (c == '{') return object(depth);
+            if (c == '[') return array(depth);
+            if (c == '"') {
+                std::optional<std::string> value = string();
+                if (!value) return std::nullopt;
+                return json_t(std::move(*value));
+            }
+            if (literal("null")) return json_t(nullptr);
+            if (literal("true")) return json_t(true);
+            if (literal("false")) return json_t(false);
+            return number();
+        }
+
+        std::optional<json_t> object(size_t depth) {
+            object_t object;
+            position++;
+            space();
+            if (literal("}")) return json_t(std::move(object));
+            while (true) {
+                space();
+                if (position == text.size() || text[position] != '"') return std::nullopt;
+                std::optional<std::string> key = string();
+                space();
+                if (!key || !literal(":")) return std::nullopt;
+                std::optional<json_t> member = value(depth + 1);
+                if (!member) return std::nullopt;
+                object.emplace_back(std::move(*key), std::move(*member));
+                space();
+                if (literal("}")) return json_t(std::move(object));
+                if (!literal(",")) return std::nullopt;
+            }
+        }
+
+        std::optional<json_t> array(size_t depth) {
+            array_t array;
+            position++;
+            space();
+            if (literal("]")) return json_t(std::move(array));
+            while (true) {
+                std::optional<json_t> element = value(depth + 1);
+                if (!element) return std::nullopt;
+                array.push_back(std::move(*element));
+                space();
+                if (literal("]")) return json_t(std::move(array));
+                if (!literal(",")) return std::nullopt;
+            }
+        }
+
+        std::optional<json_t> number() {
+            size_t start = position;
+            if (position < text.size() && text[position] == '-') position++;
+            while (position < text.size() && (std::isdigit(uint8_t(text[position])) || text[position] == '.' || text[position] == 'e' ||
+                                              text[position] == 'E' || text[position] == '+' || text[position] == '-')) {
+                position++;
+            }
+            if (position == start) return std::nullopt;
+            std::string digits{ text.substr(start, position - start) };
+            char *end = nullptr;
+            double value = std::strtod(digits.c_str(), &end);
+            if (end != digits.c_str() + digits.size()) return std::nullopt;
+            return json_t(value);
+        }
+
+        std::optional<uint32_t> hex4() {
+            if (text.size() - position < 4) return std::nullopt;
+            uint32_t value = 0;
+            for (size_t i = 0; i < 4; i++) {
+                char c = text[position++];
+                uint32_t digit = c >= '0' && c <= '9' ? c - '0' : c >= 'a' && c <= 'f' ? c - 'a' + 10 : c >= 'A' && c <= 'F' ? c - 'A' + 10 : 16;
+                if (digit == 16) return std::nullopt;
+                value = value << 4 | digit;
+            }
+            return value;
+        }
+
+        static void utf8(uint32_t code_point, std::string& out) {
+            if (code_point < 0x80) {
+                out += char(code_point);
+            } else if (code_point < 0x800) {
+                out += char(0xc0 | code_point >> 6);
+                out += char(0x80 | (code_point & 0x3f));
+            } else if (code_point < 0x10000) {
+                out += char(0xe0 | code_point >> 12);
+                out += char(0x80 | (code_point >> 6 & 0x3f));
+                out += char(0x80 | (code_point & 0x3f));
+            } else {
+                out += char(0xf0 | code_point >> 18);
+                out += char(0x80 | (code_point >> 12 & 0x3f));
+                out += char(0x80 | (code_point >> 6 & 0x3f));
+                out += char(0x80 | (code_point & 0x3f));
+            }
+        }
+
+        std::optional<std::string> string() {
+            std::string out;
+            position++;
+            while (position < text.size()) {
+                char c = text[position++];
+                if (c == '"') return out;
+                if (c != '\\') {
+                    out += c;
+                    continue;
+                }
+                if (position == text.size()) return std::nullopt;
+                switch (text[position++]) {
+                    case '"': out += '"'; break;
+                    case '\\': out += '\\'; break;
+                    case '/': out += '/'; break;
+                    case 'b': out += '\b'; break;
+                    case 'f': out += '\f'; break;
+                    case 'n': out += '\n'; break;
+                    case 'r': out += '\r'; break;
+                    case 't': out += '\t'; break;
+                    case 'u': {
+                        std::optional<uint32_t> unit = hex4();
+                        if (!unit) return std::nullopt;
+                        uint32_t code_point = *unit;
+                        // a surrogate pair is one code point outside the basic plane
+                        if (code_point >= 0xd800 && code_point < 0xdc00 && literal("\\u")) {
+                            std::optional<uint32_t> low = hex4();
+                            if (!low || *low < 0xdc00 || *low >= 0xe000) return std::nullopt;
+                            code_point = 0x10000 + ((code_point - 0xd800) << 10) + (*low - 0xdc00);
+                        }
+                        utf8(code_point, out);
+                        break;
+                    }
+                    default:
+                        return std::nullopt;
+                }
+            }
+            return std::nullopt;
+        }
+    };
+
+private:
+    std::variant<std::nullptr_t, bool, double, std::string, array_t, object_t> _value;
+};
+
+} // namespace sl
+
+#endif
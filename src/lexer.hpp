@@ -1,212 +1,371 @@
 #ifndef LEXER_HPP
 #define LEXER_HPP
 
+#include <algorithm>
+#include <istream>
 #include <string>
+#include <string_view>
 #include <sstream>
+#include <stdexcept>
 #include <optional>
 #include <vector>
 
+#include "token.hpp"
+#include "scan.hpp"
+#include "dfa_lexer.hpp"
+
 namespace sl {
 
-enum class token_type_t : uint32_t {
-    e_undefined = 0,
+// token sources are what the parser pulls from, they peek a few tokens ahead of the current one
 
-    e_int,          // int
-    e_identifier,   // name
-    e_if,           // if
+// random access over a lexed buffer, tokens and src are borrowed and must outlive the source
+// [begin, end) restricts it to a range of the buffer, token indices stay those of the whole buffer
+class buffer_token_source_t {
+public:
+    buffer_token_source_t(const token_buffer_t& tokens, std::string_view src, size_t begin = 0, size_t end = ~size_t(0))
+      : _tokens(tokens), _src(src), _index(begin), _end(std::min(end, tokens.size())) {}
 
-    e_number,       // 8  
+    bool done() const {
+        return _index >= _end;
+    }
 
-    e_assign,       // =
-    e_plus,         // +
-    e_minus,        // -
-    e_equal,        // ==
-    e_lbrace,       // {
-    e_rbrace,       // }
-    e_lbracket,     // (
-    e_rbracket,     // )
+    token_type_t peek(size_t offset = 0) const {
+        if (_index + offset >= _end) return token_type_t::e_end;
+        return _tokens.types[_index + offset];
+    }
 
-    e_semicolon,    // ;
+    token_t get(size_t offset = 0) const {
+        return _tokens[_index + offset];
+    }
 
-    e_end = std::numeric_limits<uint32_t>::max(),
-};
+    std::string_view text(size_t offset = 0) const {
+        return _src.substr(_tokens.offsets[_index + offset], _tokens.lengths[_index + offset]);
+    }
+
+    // source offset of a token, the end of the source past the last one
+    uint64_t position(size_t offset = 0) const {
+        if (_index + offset >= _tokens.size()) return _src.size();
+        return _tokens.offsets[_index + offset];
+    }
+
+    // index in the buffer of the current token
+    size_t index() const {
+        return _index;
+    }
+
+    void advance(size_t count) {
+        _index += count;
+    }
 
-struct token_t {
-    token_type_t type;
-    std::string text;  
+private:
+    const token_buffer_t& _tokens;
+    std::string_view _src;
+    size_t _index;
+    size_t _end;
 };
 
-struct lexer_t {
-public:
-    lexer_t(const std::string src) 
-      : _src(src) {}
-
-    std::optional<token_t> next() {
-        token_t token{};
-        while (auto c = try_get()) {
-            if (isspace(*c)) {
-                _index++;
-                continue;
+// lexes the next token from [pos, end), shared by the in memory and the streaming lexer
+// partial is true when more input may follow end, in_comment carries a comment across chunks
+inline lex_step_t lex_token(const char *pos, const char *end, bool partial, bool& in_comment) {
+    const scan::scanner_t& scanner = scan::scanner();
+
+    // runs are mostly short, so the first bytes are checked inline and only longer runs go to the vector scanner
+    auto skip = [end](const char *run, uint8_t mask, const char *(*scan_run)(const char *, const char *)) {
+        constexpr size_t inline_bytes = 8;
+        const char *limit = end - run < ptrdiff_t(inline_bytes) ? end : run + inline_bytes;
+        while (run != limit) {
+            if (!scan::is(*run, mask)) return run;
+            run++;
+        }
+        if (run == end) return run;
+        return scan_run(run, end);
+    };
+
+    if (in_comment) {
+        pos = scanner.find_newline(pos, end);
+        if (pos == end && partial) return { lex_status_t::e_more, token_type_t::e_undefined, end, end };
+        in_comment = false;
+    }
+
+    while (pos != end) {
+        char c = *pos;
+        if (scan::is(c, scan::e_space)) {
+            pos = skip(pos + 1, scan::e_space, scanner.skip_whitespace);
+            continue;
+        }
+        const char *start = pos;
+        if (scan::is(c, scan::e_alpha)) {
+            // get word
+            pos = skip(pos + 1, scan::e_alpha | scan::e_digit, scanner.skip_alnum);
+            if (pos == end && partial) return { lex_status_t::e_more, token_type_t::e_undefined, start, end };
+            std::string_view word{ start, size_t(pos - start) };
+            if (word == "if") {
+                // return if token
+                return { lex_status_t::e_token, token_type_t::e_if, start, pos };
             }
-            if (*c == '\n') {
-                _index++;
-                continue;
+            if (word == "int") {
+                // return int token
+                return { lex_status_t::e_token, token_type_t::e_int, start, pos };
             }
-            if (isalpha(*c)) {
-                // get word
-                std::string word{ *c };
-                _index++;
-                while (auto next = try_get()) {
-                    if (isspace(*next)) {
-                        break;
-                    }
-                    if (isalnum(*next)) {
-                        word += *next;
-                        _index++;
-                    } else {
-                        break;
-                    }
+            // return identifier
+            return { lex_status_t::e_token, token_type_t::e_identifier, start, pos };
+        }
+        if (scan::is(c, scan::e_digit)) {
+            // get number
+            pos = skip(pos + 1, scan::e_digit, scanner.skip_digits);
+            if (pos == end && partial) return { lex_status_t::e_more, token_type_t::e_undefined, start, end };
+            // return number
+            return { lex_status_t::e_token, token_type_t::e_number, start, pos };
+        }
+        // special char
 
-                }
-                if (word == "if") {
-                    // return if token
-                    token.type = token_type_t::e_if;
-                    token.text = word;
-                    return token;
-                }
-                if (word == "int") {
-                    // return int token
-                    token.type = token_type_t::e_int;
-                    token.text = word;
-                    return token;
-                }
-                // return identifier
-                token.type = token_type_t::e_identifier;
-                token.text = word;
-                return token;
+        // =
+        if (c == '=') {
+            if (pos + 1 == end && partial) return { lex_status_t::e_more, token_type_t::e_undefined, start, end };
+            // ==
+            if (pos + 1 != end && pos[1] == '=') {
+                return { lex_status_t::e_token, token_type_t::e_equal, start, pos + 2 };
             }
-            if (isdigit(*c)) {
-                // get number
-                std::string number{ *c };
-                _index++;
-                while (auto next = try_get()) {
-                    if (!isdigit(*next)) break;
-                    _index++;
-                    number += *next;    
-                }
-                // return number
-                token.type = token_type_t::e_number;
-                token.text = number;
-                return token;
+            return { lex_status_t::e_token, token_type_t::e_assign, start, pos + 1 };
+        }
+        token_type_t type = token_type_t::e_undefined;
+        switch (c) {
+            case '+': type = token_type_t::e_plus; break;
+            case '-': type = token_type_t::e_minus; break;
+            case '{': type = token_type_t::e_lbrace; break;
+            case '}': type = token_type_t::e_rbrace; break;
+            case '(': type = token_type_t::e_lbracket; break;
+            case ')': type = token_type_t::e_rbracket; break;
+            case ';': type = token_type_t::e_semicolon; break;
+            default: break;
+        }
+        if (type != token_type_t::e_undefined) {
+            return { lex_status_t::e_token, type, start, pos + 1 };
+        }
+        // // comments
+        if (c == '/') {
+            pos = scanner.find_newline(pos + 1, end);
+            if (pos == end && partial) {
+                in_comment = true;
+                return { lex_status_t::e_more, token_type_t::e_undefined, end, end };
             }
-            // special char
-
-            // =
-            if (*c == '=') {
-                // ==
-                auto next = try_get(1);
-                if (*next == '=') {
-                    token.type = token_type_t::e_equal;
-                    token.text = "==";
-                    _index += 2;
-                    return token;
+            continue;
+        }
+        throw std::runtime_error(std::string("unexpected char ") + c);
+    }
+    if (partial) return { lex_status_t::e_more, token_type_t::e_undefined, end, end };
+    return { lex_status_t::e_end, token_type_t::e_end, end, end };
+}
+
+enum class lexer_engine_t {
+    e_hand_written,  // lex_token
+    e_dfa,           // dfa::lex_token, see dfa_lexer.hpp
+};
+
+inline lex_step_t lex_token(lexer_engine_t engine, const char *pos, const char *end, bool partial, bool& in_comment) {
+    if (engine == lexer_engine_t::e_dfa) return dfa::lex_token(pos, end, partial, in_comment);
+    return lex_token(pos, end, partial, in_comment);
+}
+
+struct lexer_t {
+public:
+    // src is borrowed, it must outlive the lexer and the tokens
+    lexer_t(std::string_view src, lexer_engine_t engine = lexer_engine_t::e_hand_written) 
+      : _src(src), _engine(engine) {}
+
+    token_t next() {
+        const char *begin = _src.data();
+        lex_step_t step = lex_token(_engine, begin + _index, begin + _src.size(), false, _in_comment);
+        _index = step.stop - begin;
+        return { step.type, uint32_t(step.stop - step.start), uint64_t(step.start - begin) };
+    }
+
+    // next() for sources that are still being typed, a character that is not part of the language comes back as
+    // an e_undefined token of length 1 instead of throwing and lexing goes on after it
+    token_t next_tolerant() {
+        try {
+            return next();
+        } catch (const std::runtime_error&) {
+            // next() threw after skipping the whitespace and comments in front of the character
+            uint64_t index = _index;
+            while (index < _src.size()) {
+                if (scan::is(_src[index], scan::e_space)) {
+                    index++;
+                } else if (_src[index] == '/') {
+                    index = std::min(_src.find('\n', index), _src.size());
+                } else {
+                    break;
                 }
-                token.type = token_type_t::e_assign;
-                token.text = *c;
-                _index++;
-                return token;
-            }
-            // +
-            if (*c == '+') {
-                token.type = token_type_t::e_plus;
-                token.text = *c;
-                _index++;
-                return token;
-            }
-            // -
-            if (*c == '-') {
-                token.type = token_type_t::e_minus;
-                token.text = *c;
-                _index++;
-                return token;
-            }
-            // {
-            if (*c == '{') {
-                token.type = token_type_t::e_lbrace;
-                token.text = *c;
-                _index++;
-                return token;
-            }
-            // }
-            if (*c == '}') {
-                token.type = token_type_t::e_rbrace;
-                token.text = *c;
-                _index++;
-                return token;
             }
-             // (
-            if (*c == '(') {
-                token.type = token_type_t::e_lbracket;
-                token.text = *c;
-                _index++;
-                return token;
-            }
-            // )
-            if (*c == ')') {
-                token.type = token_type_t::e_rbracket;
-                token.text = *c;
-                _index++;
-                return token;
-            }
-            // ;
-            if (*c == ';') {
-                token.type = token_type_t::e_semicolon;
-                token.text = *c;
-                _index++;
-                return token;
+            _index = index + 1;
+            _in_comment = false;
+            return { token_type_t::e_undefined, 1, index };
+        }
+    }
+
+    // continues at offset, which has to be the start of a token or between tokens outside of a comment
+    void seek(uint64_t offset) {
+        _index = offset;
+        _in_comment = false;
+    }
+
+    token_buffer_t tokens() {
+        token_buffer_t tokens;
+        this->tokens(tokens);
+        return tokens;
+    }
+
+    // into a buffer kept from an earlier compile, it is cleared first but keeps its capacity
+    void tokens(token_buffer_t& tokens) {
+        tokens.clear();
+        // most tokens are short and separated by whitespace
+        tokens.reserve(_src.size() / 4 + 16);
+        while (true) {
+            token_t token = next();
+            if (token.type == sl::token_type_t::e_end) break;
+            if (token.type == sl::token_type_t::e_undefined) {
+                throw std::runtime_error("Failed to lex token");
             }
-            // // comments
-            if (*c == '/') {
-                _index++;
-                while (auto next = try_get()) {
-                    if (*next == '\n') break;
-                    _index++;
-                }
+            tokens.push_back(token);
+        }
+    }
+
+private:
+    std::string_view _src;
+    lexer_engine_t _engine;
+    uint64_t _index{ 0 };
+    bool _in_comment{ false };
+};
+
+// pulls tokens from an istream chunk by chunk, memory is bounded by the chunk size and the longest token
+// instead of the size of the input, token offsets are absolute positions in the stream
+class stream_lexer_t {
+public:
+    stream_lexer_t(std::istream& input, size_t chunk_size = 64 * 1024, lexer_engine_t engine = lexer_engine_t::e_hand_written)
+      : _input(input), _chunk_size(chunk_size), _engine(engine) {}
+
+    token_t next() {
+        while (true) {
+            const char *begin = _buffer.data();
+            const char *end = begin + _buffer.size();
+            lex_step_t step = lex_token(_engine, begin + _index, end, !_eof, _in_comment);
+            if (step.status == lex_status_t::e_more) {
+                _index = step.start - begin;
+                refill();
                 continue;
             }
-            throw std::runtime_error(std::string("unexpected char ") + *c);
+            _index = step.stop - begin;
+            return { step.type, uint32_t(step.stop - step.start), _base + (step.start - begin) };
         }
-        return { {token_type_t::e_end} };
     }
 
-    std::vector<token_t> tokens() {
-        std::vector<token_t> tokens;
-        while (auto token = next()) {
-            if (token->type == sl::token_type_t::e_end) break;
-            if (token->type == sl::token_type_t::e_undefined) {
-                throw std::runtime_error("Failed to lex token");
-            }
-            tokens.push_back(*token);
+    // text of a token that has not been released yet
+    std::string_view text(const token_t& token) const {
+        return { _buffer.data() + (token.offset - _base), token.length };
+    }
+
+    // bytes before position are no longer referenced and may be dropped on the next refill
+    void release(uint64_t position) {
+        _released = position;
+    }
+
+private:
+    void refill() {
+        // keep everything from the oldest byte that is still referenced
+        uint64_t keep = std::min(_released, _base + _index);
+        if (keep > _base) {
+            size_t drop = keep - _base;
+            _buffer.erase(0, drop);
+            _base += drop;
+            _index -= drop;
         }
-        return tokens;
+        size_t size = _buffer.size();
+        _buffer.resize(size + _chunk_size);
+        _input.read(_buffer.data() + size, _chunk_size);
+        _buffer.resize(size + _input.gcount());
+        if (_input.gcount() == 0 || _input.eof()) _eof = true;
+    }
+
+private:
+    std::istream& _input;
+    size_t _chunk_size;
+    lexer_engine_t _engine;
+    std::string _buffer;
+    uint64_t _base{ 0 };      // stream position of _buffer[0]
+    uint64_t _index{ 0 };     // into _buffer
+    uint64_t _released{ 0 };
+    bool _eof{ false };
+    bool _in_comment{ false };
+};
+
+// pulls from a stream_lexer_t into a small ring of lookahead tokens, the lexer may drop
+// source bytes once they fall behind the window
+class stream_token_source_t {
+public:
+    static constexpr size_t window_size = 8;  // power of 2, more than the parser ever peeks ahead
+
+    stream_token_source_t(stream_lexer_t& lexer) : _lexer(lexer) {}
+
+    bool done() {
+        return peek(0) == token_type_t::e_end;
+    }
+
+    token_type_t peek(size_t offset = 0) {
+        return get(offset).type;
+    }
+
+    token_t get(size_t offset = 0) {
+        fill(offset);
+        if (offset >= _count) return _window[(_head + _count - 1) & (window_size - 1)];  // e_end
+        return _window[(_head + offset) & (window_size - 1)];
+    }
+
+    std::string_view text(size_t offset = 0) {
+        return _lexer.text(get(offset));
+    }
+
+    uint64_t position(size_t offset = 0) {
+        return get(offset).offset;
+    }
+
+    size_t index() const {
+        return _index;
+    }
+
+    void advance(size_t count) {
+        fill(count);
+        count = std::min(count, _count - 1);
+        _index += count;
+        _head = (_head + count) & (window_size - 1);
+        _count -= count;
+        _lexer.release(_window[_head].offset);
     }
 
 private:
-    std::optional<char> try_get(uint32_t offset = 0) {
-        if (_index + offset >= _src.size()) return std::nullopt;
-        return _src[_index + offset];
+    void fill(size_t offset) {
+        if (offset >= window_size) throw std::runtime_error("lookahead past the token window");
+        while (_count <= offset) {
+            if (_count && _window[(_head + _count - 1) & (window_size - 1)].type == token_type_t::e_end) return;
+            token_t token = _lexer.next();
+            if (token.type == token_type_t::e_undefined) throw std::runtime_error("Failed to lex token");
+            _window[(_head + _count) & (window_size - 1)] = token;
+            _count++;
+        }
     }
 
 private:
-    std::string _src;
-    uint32_t _index{ 0 };
+    stream_lexer_t& _lexer;
+    token_t _window[window_size]{};
+    size_t _head{ 0 };
+    size_t _count{ 0 };
+    size_t _index{ 0 };  // tokens advanced over so far
 };
 
 } // namespace sl
 
 namespace std {
 
-std::string to_string(const sl::token_t& token) {
+inline std::string to_string(const sl::token_t& token, std::string_view src) {
     std::stringstream s;
     s << "token type: ";
     switch (token.type) {
@@ -254,7 +413,7 @@ std::string to_string(const sl::token_t& token) {
             break;
     }
 
-    s << "\t\tvalue: " << token.text;
+    s << "\t\tvalue: " << token.text(src);
     return s.str();
 }
 
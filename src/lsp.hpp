@@ -0,0 +1,177 @@
+#ifndef LSP_HPP
+#define LSP_HPP
+
+// language server over stdio, for editors to show the errors of a document as it is typed
+// messages are json-rpc with a Content-Length header, documents are synced incrementally and every change is
+// applied to a document_t, which checks only what the change touched, before the diagnostics are published
+
+#include "document.hpp"
+#include "json.hpp"
+#include "lexer.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <istream>
+#include <limits>
+#include <optional>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+namespace sl {
+
+class language_server_t {
+public:
+    language_server_t(std::istream& input, std::ostream& output, lexer_engine_t engine = lexer_engine_t::e_hand_written)
+      : _input(input), _output(output), _engine(engine) {}
+
+    // until the exit notification or the end of the input, the exit code is 0 when shutdown came before them
+    int run() {
+        while (std::optional<std::string> body = read_message()) {
+            std::optional<json_t> message = json_t::parse(*body);
+            if (!message || !message->is_object()) {
+                write_error(nullptr, -32700, "parse error");
+                continue;
+            }
+            const std::string& method = (*message)["method"].string();
+            if (method == "exit") return _shutdown ? EXIT_SUCCESS : EXIT_FAILURE;
+            handle(method, *message);
+        }
+        return _shutdown ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
+private:
+    // documents are far smaller, a longer body is skipped rather than allocated and answered as a parse error
+    static constexpr size_t max_body = size_t(64) << 20;
+
+    // the body of the next message, nullopt at the end of the input
+    std::optional<std::string> read_message() {
+        size_t length = 0;
+        bool has_length = false;
+        std::string line;
+        while (std::getline(_input, line)) {
+            if (!line.empty() && line.back() == '\r') line.pop_back();
+            if (line.empty()) {
+                if (!has_length) continue;
+                if (length > max_body) {
+                    std::streamsize skip = std::streamsize(std::min<size_t>(length, std::numeric_limits<std::streamsize>::max()));
+                    if (_input.ignore(skip).gcount() < skip) return std::nullopt;
+                    return std::string();
+                }
+                std::string body(length, '\0');
+                if (!_input.read(body.data(), length)) return std::nullopt;
+                return body;
+            }
+            constexpr std::string_view content_length = "Content-Length:";
+            if (line.compare(0, content_length.size(), content_length) == 0) {
+                length = std::strtoull(line.c_str() + content_length.size(), nullptr, 10);
+                has_length = true;
+            }
+        }
+        return std::nullopt;
+    }
+
+    void write_message(json_t::object_t message) {
+        message.insert(message.begin(), { "jsonrpc", "2.0" });
+        std::string body = json_t(std::move(message)).dump();
+        _output << "Content-Length: " << body.size() << "\r\n\r\n" << body;
+        _output.flush();
+    }
+
+    void write_result(const json_t& id, json_t result) {
+        write_message({ { "id", id }, { "result", std::move(result) } });
+    }
+
+    void write_error(const json_t& id, int code, std::string_view message) {
+        write_message({ { "id", id }, { "error", json_t::object_t{ { "code", code }, { "message", message } } } });
+    }
+
+    void handle(const std::string& method, const json_t& message) {
+        const json_t& id = message["id"];
+        const json_t& params = message["params"];
+        bool request = message.contains("id");
+
+        if (method == "initialize") {
+            json_t::object_t sync{ { "openClose", true }, { "change", 2 } };  // incremental
+            json_t::object_t capabilities{ { "textDocumentSync", std::move(sync) } };
+            write_result(id, json_t::object_t{ { "capabilities", std::move(capabilities) }, { "serverInfo", json_t::object_t{ { "name", "simpleLang" } } } });
+        } else if (method == "shutdown") {
+            _shutdown = true;
+            write_result(id, nullptr);
+        } else if (method == "textDocument/didOpen") {
+            const json_t& document = params["textDocument"];
+            const std::string& uri = document["uri"].string();
+            _documents.erase(uri);
+            _documents.try_emplace(uri, document["text"].string(), _engine);
+            publish(uri, document["version"]);
+        } else if (method == "textDocument/didChange") {
+            const json_t& document = params["textDocument"];
+            const std::string& uri = document["uri"].string();
+            auto it = _documents.find(uri);
+            if (it == _documents.end()) return;
+            for (const json_t& change : params["contentChanges"].array()) {
+                change_document(it->second, change);
+            }
+            publish(uri, document["version"]);
+        } else if (method == "textDocument/didClose") {
+            const std::string& uri = params["textDocument"]["uri"].string();
+            _documents.erase(uri);
+            // the editor forgets the diagnostics of a closed document only once they are cleared
+            write_message({ { "method", "textDocument/publishDiagnostics" },
+                            { "params", json_t::object_t{ { "uri", uri }, { "diagnostics", json_t::array_t{} } } } });
+        } else if (request) {
+            write_error(id, -32601, "method not found: " + method);
+        }
+        // other notifications, initialized, didSave, $/ ones, need nothing
+    }
+
+    // a line or character as sent, negative and NaN are 0 and past uint32_t is clamped, document_t::offset clamps to the text
+    static uint64_t position_number(const json_t& value) {
+        double number = value.number();
+        if (!(number >= 0)) return 0;
+        return number < 0x1p32 ? uint64_t(number) : UINT32_MAX;
+    }
+
+    // a change with a range replaces it, one without replaces the whole document
+    static void change_document(document_t& document, const json_t& change) {
+        const std::string& text = change["text"].string();
+        if (!change.contains("range")) {
+            document.edit(0, document.text().size(), text);
+            return;
+        }
+        const json_t& start = change["range"]["start"];
+        const json_t& end = change["range"]["end"];
+        uint64_t begin = document.offset(position_number(start["line"]), position_number(start["character"]));
+        uint64_t stop = document.offset(position_number(end["line"]), position_number(end["character"]));
+        document.edit(begin, std::max(begin, stop), text);
+    }
+
+    void publish(const std::string& uri, const json_t& version) {
+        const document_t& document = _documents.at(uri);
+        auto position = [&](uint64_t offset) {
+            auto [line, character] = document.position(offset);
+            return json_t::object_t{ { "line", line }, { "character", character } };
+        };
+        json_t::array_t diagnostics;
+        for (const diagnostic_t& diagnostic : document.diagnostics()) {
+            json_t::object_t range{ { "start", position(diagnostic.offset) }, { "end", position(diagnostic.offset + diagnostic.length) } };
+            diagnostics.push_back(json_t::object_t{ { "range", std::move(range) }, { "severity", 1 }, { "source", "simpleLang" }, { "message", diagnostic.message } });
+        }
+        json_t::object_t params{ { "uri", uri }, { "diagnostics", std::move(diagnostics) } };
+        if (version.is_number()) params.emplace_back("version", version);
+        write_message({ { "method", "textDocument/publishDiagnostics" }, { "params", std::move(params) } });
+    }
+
+private:
+    std::istream& _input;
+    std::ostream& _output;
+    lexer_engine_t _engine;
+    bool _shutdown{ false };
+    std::unordered_map<std::string, document_t> _documents;  // by uri
+};
+
+} // namespace sl
+
+#endif
@@ -1,51 +1,283 @@
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
 #include <iostream>
+#include <map>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <vector>
 
 #include "utility.hpp"
-#include "lexer.hpp"
-#include "parser.hpp"
-#include "interpreter.hpp"
-#include "code_gen.hpp"
-
-std::ostream& operator<<(std::ostream& o, const sl::token_t& token) {
-    o << std::to_string(token);
-    return o;
+#include "batch_io.hpp"
+#include "cli.hpp"
+#include "compiler.hpp"
+#include "incremental.hpp"
+#include "lsp.hpp"
+#include "server.hpp"
+#include "thread_pool.hpp"
+#include "watch.hpp"
+
+namespace {
+
+// the main thread keeps reads and writes in flight through batch_io_t while the pool compiles
+// the files that are in, at most window files are held in memory at once
+std::vector<std::string> compile_batch(const sl::cli_options_t& options, sl::cache_t *cache) {
+    const std::vector<std::string>& inputs = options.inputs;
+    std::vector<std::filesystem::path> outputs = sl::output_paths(options);
+    std::vector<std::string> errors(inputs.size());
+
+    struct compiled_t {
+        size_t index;
+        bool ok;
+        std::string text;  // the output or the error
+    };
+    std::mutex compiled_mutex;
+    std::condition_variable compiled_ready;
+    std::vector<compiled_t> compiled;
+
+    sl::batch_io_t io{ options.io_uring };
+    sl::thread_pool_t pool{ options.jobs };
+    size_t window = options.jobs * 4;
+    size_t next = 0;
+    size_t active = 0;
+    size_t compiling = 0;
+    size_t finished = 0;
+
+    auto fail = [&](size_t index, std::string error) {
+        errors[index] = std::move(error);
+        finished++;
+        active--;
+    };
+
+    while (finished < inputs.size()) {
+        for (; next < inputs.size() && active < window; next++, active++) {
+            io.read(next, inputs[next]);
+        }
+
+        for (sl::io_result_t& result : io.wait()) {
+            size_t index = result.index;
+            if (result.error) {
+                std::string what = result.write ? "failed to write " + outputs[index].string() : "failed to open " + inputs[index];
+                fail(index, inputs[index] + ": " + what + ": " + std::strerror(result.error));
+            } else if (result.write) {
+                finished++;
+                active--;
+            } else {
+                compiling++;
+                pool.submit([&, index, source = std::move(result.data)] {
+                    compiled_t done{ index, false, {} };
+                    try {
+                        auto result = sl::compile(source, options.compile, nullptr, cache);
+                        done.ok = bool(result);
+                        done.text = result ? result.unwrap() : result.unwrapErr();
+                    } catch (const std::exception& error) {
+                        done.text = error.what();
+                    }
+                    std::lock_guard lock{ compiled_mutex };
+                    compiled.push_back(std::move(done));
+                    compiled_ready.notify_one();
+                });
+            }
+        }
+
+        std::vector<compiled_t> ready;
+        {
+            std::unique_lock lock{ compiled_mutex };
+            // with no io left to wait for, wait for the compiles instead
+            if (io.pending() == 0 && compiling) compiled_ready.wait(lock, [&] { return !compiled.empty(); });
+            ready.swap(compiled);
+        }
+        for (compiled_t& done : ready) {
+            compiling--;
+            if (done.ok) {
+                io.write(done.index, outputs[done.index].string(), std::move(done.text));
+            } else {
+                fail(done.index, inputs[done.index] + ": " + done.text);
+            }
+        }
+    }
+    return errors;
 }
 
-int main(int argc, char **argv) {
-    // if (argc < 2 || argc > 2) {
-    //     std::cout << "./simpleLang {path to .sl src}\n"; 
-    //     exit(EXIT_FAILURE);
-    // }
-    // std::string src = sl::read_file(argv[1]);
-    std::string src = sl::read_file("../example.sl");
+void print_cache_stats(const sl::cache_t& cache) {
+    sl::cache_stats_t stats = cache.stats();
+    std::cerr << "cache " << cache.directory().string() << ": " << stats.hits << " hits, " << stats.misses << " misses, "
+              << stats.stores << " stores, " << stats.evictions << " evictions, "
+              << stats.entries << " entries in " << stats.bytes << " bytes\n";
+}
+
+#ifdef SL_HAS_INOTIFY
+// compiles the inputs, then again each time one is saved, runs until killed
+// the asm is compiled incrementally, the time and the statements redone go to stderr after every compile
+int watch(const sl::cli_options_t& options, sl::cache_t *cache) {
+    const std::vector<std::string>& inputs = options.inputs;
+    std::vector<std::filesystem::path> outputs;
+    if (options.output_dir) outputs = sl::output_paths(options);
+    // --run and --emit-ast have no incremental form, those are compiled whole
+    bool incremental = !options.compile.run && !options.compile.emit_ast;
+    std::vector<sl::incremental_compiler_t> compilers;
+    compilers.reserve(inputs.size());
+    for (size_t i = 0; i < inputs.size(); i++) compilers.emplace_back(options.compile.engine);
+
+    auto compile = [&](size_t index) {
+        const std::string& input = inputs[index];
+        auto start = std::chrono::steady_clock::now();
+        try {
+            sl::source_t source{ input };
+            auto result = incremental ? compilers[index].compile(source.view()) : sl::compile(source.view(), options.compile, nullptr, cache);
+            double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+            if (!result) {
+                std::cerr << input << ": " << result.unwrapErr() << '\n';
+                return;
+            }
+            std::string text = result.unwrap();
+            if (options.output_dir) {
+                std::ofstream file{ outputs[index], std::ios::binary };
+                if (!file.write(text.data(), text.size())) std::cerr << input << ": failed to write " << outputs[index].string() << '\n';
+            } else {
+                std::cout << text << std::flush;
+            }
+            std::cerr << input << ": " << ms << " ms";
+            if (incremental) {
+                const sl::incremental_stats_t& stats = compilers[index].stats();
+                std::cerr << ", " << stats.reparsed << " of " << stats.units << " statements parsed, " << stats.regenerated << " generated";
+            }
+            std::cerr << '\n';
+        } catch (const std::runtime_error& error) {
+            std::cerr << input << ": " << error.what() << '\n';
+        }
+    };
 
-    sl::lexer_t lexer{ src };
-    std::vector<sl::token_t> tokens = lexer.tokens();
+    try {
+        // watching first, a save during the first compile is not missed
+        sl::watcher_t watcher{ inputs };
+        for (size_t i = 0; i < inputs.size(); i++) compile(i);
+        for (;;) {
+            for (size_t index : watcher.wait()) compile(index);
+        }
+    } catch (const std::runtime_error& error) {
+        std::cerr << error.what() << '\n';
+    }
+    return EXIT_FAILURE;
+}
+#endif
 
-    // for (auto& token : tokens) {
-    //     std::cout << token << '\n';
-    // }
+} // namespace
 
-    sl::parser_t parser{ tokens };
+int main(int argc, char **argv) {
+    std::optional<sl::cli_options_t> options = sl::parse_args(argc, argv);
+    if (!options) {
+        sl::usage("./simpleLang");
+        exit(EXIT_FAILURE);
+    }
 
-    auto result = parser.parse();
+    std::optional<sl::cache_t> cache;
+    if (options->cache_dir) {
+        try {
+            cache.emplace(*options->cache_dir, options->cache_bytes);
+        } catch (const std::runtime_error& error) {
+            std::cerr << error.what() << '\n';
+            return EXIT_FAILURE;
+        }
+    }
 
-    if (!result) {
-        throw std::runtime_error(result.unwrapErr());
+    if (options->serve) {
+#ifdef SL_HAS_UNIX_SOCKETS
+        try {
+            sl::server_t server{ *options->serve, options->jobs, cache ? &*cache : nullptr };
+            server.run();
+        } catch (const std::runtime_error& error) {
+            std::cerr << error.what() << '\n';
+        }
+#else
+        std::cerr << "--serve needs unix domain sockets\n";
+#endif
+        return EXIT_FAILURE;
     }
 
-    auto [ast, identifier_table] = result.unwrap();
+    if (options->lsp) {
+        std::ios::sync_with_stdio(false);
+        sl::language_server_t server{ std::cin, std::cout, options->compile.engine };
+        return server.run();
+    }
 
-    sl::interpreter_t interpreter{ ast, identifier_table };
-    // interpreter.run();
-    while (interpreter.can_run()) {
-        interpreter.run_statement();
+    if (options->watch) {
+#ifdef SL_HAS_INOTIFY
+        if (options->output_dir) {
+            std::error_code error_code;
+            std::filesystem::create_directories(*options->output_dir, error_code);
+            if (error_code) {
+                std::cerr << "failed to create " << options->output_dir->string() << ": " << error_code.message() << '\n';
+                return EXIT_FAILURE;
+            }
+        }
+        return watch(*options, cache ? &*cache : nullptr);
+#else
+        std::cerr << "--watch needs inotify\n";
+        return EXIT_FAILURE;
+#endif
     }
-    // std::cout << interpreter.get_state() << '\n';
 
-    sl::code_gen_t code_gen{ ast };
+    if (options->stream) {
+        const std::string& input = options->inputs[0];
+        std::ifstream file;
+        if (input != "-") {
+            file.open(input, std::ios::binary);
+            if (!file) {
+                std::cerr << input << ": failed to open " << input << '\n';
+                return EXIT_FAILURE;
+            }
+        }
+        std::ios::sync_with_stdio(false);
+        auto result = sl::compile_stream(input == "-" ? std::cin : file, options->compile);
+        if (!result) {
+            std::cerr << input << ": " << result.unwrapErr() << '\n';
+            return EXIT_FAILURE;
+        }
+        std::cout << result.unwrap();
+        return EXIT_SUCCESS;
+    }
 
-    std::cout << code_gen.gen() << '\n';
+    // one input on stdout, the parse of that one file is split over the threads instead
+    if (!options->output_dir) {
+        const std::string& input = options->inputs[0];
+        try {
+            sl::source_t source{ input };
+            std::optional<sl::thread_pool_t> pool;
+            if (options->jobs > 1) pool.emplace(options->jobs);
+            auto result = sl::compile(source.view(), options->compile, pool ? &*pool : nullptr, cache ? &*cache : nullptr);
+            if (cache && options->cache_stats) print_cache_stats(*cache);
+            if (!result) {
+                std::cerr << input << ": " << result.unwrapErr() << '\n';
+                return EXIT_FAILURE;
+            }
+            std::cout << result.unwrap();
+        } catch (const std::runtime_error& error) {
+            std::cerr << input << ": " << error.what() << '\n';
+            return EXIT_FAILURE;
+        }
+        return EXIT_SUCCESS;
+    }
+
+    std::error_code error_code;
+    std::filesystem::create_directories(*options->output_dir, error_code);
+    if (error_code) {
+        std::cerr << "failed to create " << options->output_dir->string() << ": " << error_code.message() << '\n';
+        return EXIT_FAILURE;
+    }
 
-    return 0;
-}
\ No newline at end of file
+    std::vector<std::string> errors = compile_batch(*options, cache ? &*cache : nullptr);
+    if (cache && options->cache_stats) print_cache_stats(*cache);
+
+    // reported in the order of the inputs
+    int status = EXIT_SUCCESS;
+    for (const std::string& error : errors) {
+        if (error.empty()) continue;
+        std::cerr << error << '\n';
+        status = EXIT_FAILURE;
+    }
+    return status;
+}
@@ -0,0 +1,147 @@
+#ifndef PARALLEL_PARSER_HPP
+#define PARALLEL_PARSER_HPP
+
+#include "parser.hpp"
+#include "thread_pool.hpp"
+
+namespace sl {
+
+// parses one large token buffer on a thread pool
+// the tokens are split after top level ; and } into chunks of whole statements, then every declaration is
+// collected with the token declaring it, so identifiers resolve exactly as in a parse in order
+// each chunk is then parsed into its own ast and the asts are merged in order; when a chunk fails the whole buffer
+// is parsed again in order, so the error is the one parser_t gives
+// parse waits on jobs of pool, so it must not be called from one of them
+class parallel_parser_t {
+public:
+    parallel_parser_t(const token_buffer_t& tokens, std::string_view src, thread_pool_t& pool, size_t chunk_tokens = 64 * 1024)
+      : _tokens(tokens), _src(src), _pool(pool), _chunk_tokens(std::max<size_t>(chunk_tokens, 1)) {}
+
+    Result<std::pair<ast_t, symbol_table_t>, error_t> parse() {
+        std::vector<size_t> bounds = split();
+        size_t chunk_count = bounds.size() - 1;
+
+        // declarations are found in parallel but interned in order, so ids are the same as in a parse in order
+        std::vector<std::future<std::vector<size_t>>> found;
+        for (size_t i = 0; i < chunk_count; i++) {
+            found.push_back(_pool.submit([this, begin = bounds[i], end = bounds[i + 1]] {
+                return find_declarations(begin, end);
+            }));
+        }
+        for (auto& future : found) {
+            for (size_t token : future.get()) {
+                std::string_view name = _src.substr(_tokens.offsets[token + 1], _tokens.lengths[token + 1]);
+                if (_declarations.symbols.insert(name).second) _declarations.tokens.push_back(token);
+            }
+        }
+
+        using chunk_result_t = Result<std::pair<ast_t, symbol_table_t>, error_t>;
+        std::vector<std::future<chunk_result_t>> futures;
+        for (size_t i = 0; i < chunk_count; i++) {
+            futures.push_back(_pool.submit([this, begin = bounds[i], end = bounds[i + 1]] {
+                parser_t parser{ _tokens, _src, begin, end };
+                parser.use_declarations(_declarations);
+                return parser.parse();
+            }));
+        }
+
+        std::vector<ast_t> chunks;
+        for (auto& future : futures) {
+            chunk_result_t result = future.get();
+            if (!result) {
+                // the later chunks still hold references to this, wait for them
+                for (auto& rest : futures) if (rest.valid()) rest.wait();
+                // a chunk starts without the declarations that failed before it and may stop at another token
+                parser_t parser{ _tokens, _src };
+                return parser.parse();
+            }
+            chunks.push_back(std::move(result.take().first));
+        }
+
+        return Ok(std::pair{ merge(chunks), std::move(_declarations.symbols) });
+    }
+
+private:
+    // chunk bounds as token indices, each chunk is at least _chunk_tokens long and ends with a top level ; or }
+    // a } closes a block only after ; } or {, after anything else it ends an expression like ; does, as the
+    // parser takes it, so in if (a) { a = 1 } the block is still open
+    std::vector<size_t> split() const {
+        std::vector<size_t> bounds{ 0 };
+        const token_type_t *types = _tokens.types.data();
+        size_t depth = 0;
+        for (size_t i = 0; i < _tokens.size(); i++) {
+            token_type_t type = types[i];
+            if (type == token_type_t::e_lbrace) {
+                depth++;
+            } else if (type == token_type_t::e_rbrace || type == token_type_t::e_semicolon) {
+                token_type_t before = i ? types[i - 1] : token_type_t::e_semicolon;
+                bool closes = before == token_type_t::e_semicolon || before == token_type_t::e_rbrace || before == token_type_t::e_lbrace;
+                if (type == token_type_t::e_rbrace && closes && depth) depth--;
+                if (depth == 0 && i + 1 - bounds.back() >= _chunk_tokens) bounds.push_back(i + 1);
+            }
+        }
+        if (bounds.back() != _tokens.size() || bounds.size() == 1) bounds.push_back(_tokens.size());
+        return bounds;
+    }
+
+    // the int tokens in [begin, end) that declare an identifier
+    std::vector<size_t> find_declarations(size_t begin, size_t end) const {
+        std::vector<size_t> tokens;
+        for (size_t i = begin; i + 1 < end; i++) {
+            if (_tokens.types[i] == token_type_t::e_int && _tokens.types[i + 1] == token_type_t::e_identifier) tokens.push_back(i);
+        }
+        return tokens;
+    }
+
+    // concatenates the chunk asts, shifting their indices by the nodes before them, one job per chunk
+    ast_t merge(std::vector<ast_t>& chunks) {
+        std::vector<uint32_t> statement_bases{ 0 };
+        std::vector<uint32_t> expression_bases{ 0 };
+        for (const ast_t& chunk : chunks) {
+            statement_bases.push_back(statement_bases.back() + chunk.statements.size());
+            expression_bases.push_back(expression_bases.back() + chunk.expressions.size());
+        }
+
+        ast_t ast;
+        ast.statements.resize(statement_bases.back());
+        ast.expressions.resize(expression_bases.back());
+
+        std::vector<std::future<void>> futures;
+        for (size_t i = 0; i < chunks.size(); i++) {
+            futures.push_back(_pool.submit([&, i] {
+                uint32_t statement_base = statement_bases[i];
+                uint32_t expression_base = expression_bases[i];
+
+                statement_t *statements = ast.statements.data() + statement_base;
+                for (statement_t statement : chunks[i].statements) {
+                    if (statement.expression != ast_t::npos) statement.expression += expression_base;
+                    if (statement.type == statement_type_t::e_if) statement.end += statement_base;
+                    *statements++ = statement;
+                }
+
+                expression_t *expressions = ast.expressions.data() + expression_base;
+                for (expression_t expression : chunks[i].expressions) {
+                    if (expression.type == expression_type_t::e_binary) {
+                        expression.as.binary.left += expression_base;
+                        expression.as.binary.right += expression_base;
+                    }
+                    *expressions++ = expression;
+                }
+            }));
+        }
+        for (auto& future : futures) future.get();
+        return ast;
+    }
+
+private:
+    const token_buffer_t& _tokens;
+    std::string_view _src;
+    thread_pool_t& _pool;
+    size_t _chunk_tokens;
+
+    declarations_t _declarations;
+};
+
+} // namespace sl
+
+#endif
@@ -1,8 +1,9 @@
 #ifndef PARSER_HPP
 #define PARSER_HPP
 
+#include "error.hpp"
 #include "lexer.hpp"
-#include "pool.hpp"
+#include "symbol_table.hpp"
 
 #include "result.hpp"
 
@@ -10,351 +11,517 @@
 #include <cstring>
 #include <string>
 #include <algorithm>
+#include <charconv>
+#include <type_traits>
+#include <vector>
 
 using namespace std::literals::string_literals;
 
 namespace sl {
 
-struct identifier_t {
-    uint32_t id;  // index into identifier table, TODO add scope ?
+enum expression_type_t : uint8_t {
+    e_identifier, // a
+    e_number,     // 1
+    e_binary,     // a + expression
 };
 
-struct number_t {
-    uint32_t number;
-};
-
-enum declaration_type_t {
-    e_simple, // int a;
-    e_complex, // int a = expr;
-};
-
-struct expression_t;
-
-struct declaration_t {
-    declaration_type_t type;
-    union as_t {
-        struct simple_t {
-            identifier_t *identifier;
-        } simple;
-        struct complex_t {
-            identifier_t *identifier;
-            expression_t *expression;
-        } complex;
-    } as;
-};
-
-enum expression_type_t {
-    e_unary,  // a;
-    e_binary, // a + expression;
-};
-
-enum unary_type_t {
-    e_identifier,
-    e_number,
+enum class op_t : uint8_t {
+    e_assign,
+    e_plus,
+    e_minus,
+    e_equal,
 };
 
+// 12 bytes, operands are indices into ast_t::expressions and always come before the expression using them
 struct expression_t {
     expression_type_t type;
+    op_t op;  // e_binary only
     union as_t {
-        struct unary_t {
-            unary_type_t type;
-            union as_t {
-                identifier_t *identifier;
-                number_t *number;
-            } as;
-        } unary;
+        uint32_t id;  // id in the symbol table, TODO add scope ?
+        uint32_t number;
         struct binary_t {
-            expression_t *left_expression;
-            token_t *op;
-            expression_t *right_expression;
+            uint32_t left;
+            uint32_t right;
         } binary;
     } as;
 };
 
-struct statement_t;
-
-struct if_t {
-    expression_t *expression;
-    std::vector<statement_t *>truthy;
-};
-
-enum statement_type_t {
-    e_declaration,
+enum statement_type_t : uint8_t {
+    e_declaration, // int a; or int a = expr;
     e_expression,
     e_if,
 };
 
+// the body of an if is stored right after it, so a block is a contiguous range of statements
 struct statement_t {
     statement_type_t type;
-    union as_t {
-        declaration_t *declaration;
-        expression_t *expression;
-        if_t *_if;
-    } as;
+    uint32_t id;          // e_declaration, the declared symbol
+    uint32_t expression;  // the initializer of a declaration or ast_t::npos, the expression, the condition of an if
+    uint32_t end;         // e_if, one past the last statement of the body
 };
 
+// a pointer and a size, for the arrays of an ast that may live in a vector or in a mapped file
+template <typename T>
+class span_t {
+public:
+    span_t() = default;
+    span_t(T *data, size_t size) : _data(data), _size(size) {}
+
+    template <typename U, typename = std::enable_if_t<std::is_same_v<const U, T>>>
+    span_t(const std::vector<U>& vector) : _data(vector.data()), _size(vector.size()) {}
+
+    T& operator[](size_t index) const {
+        return _data[index];
+    }
+
+    T *data() const {
+        return _data;
+    }
+
+    size_t size() const {
+        return _size;
+    }
+
+    T *begin() const {
+        return _data;
+    }
+
+    T *end() const {
+        return _data + _size;
+    }
+
+private:
+    T *_data{ nullptr };
+    size_t _size{ 0 };
+};
+
+// flat ast, the nodes live in two arrays and refer to each other by index
+// move only, the compile pipeline hands the ast along instead of copying it
 struct ast_t {
-    std::vector<statement_t *> statements;
+    static constexpr uint32_t npos = ~0u;
+
+    ast_t() = default;
+    ast_t(const ast_t&) = delete;
+    ast_t& operator=(const ast_t&) = delete;
+    ast_t(ast_t&&) = default;
+    ast_t& operator=(ast_t&&) = default;
+
+    // the statement following index in the same block, skips over the body of an if
+    uint32_t next(uint32_t index) const {
+        const statement_t& statement = statements[index];
+        return statement.type == statement_type_t::e_if ? statement.end : index + 1;
+    }
+
+    uint32_t add_identifier(uint32_t id) {
+        expression_t expression{};
+        expression.type = expression_type_t::e_identifier;
+        expression.as.id = id;
+        return add(expression);
+    }
+
+    uint32_t add_number(uint32_t number) {
+        expression_t expression{};
+        expression.type = expression_type_t::e_number;
+        expression.as.number = number;
+        return add(expression);
+    }
+
+    uint32_t add_binary(uint32_t left, op_t op, uint32_t right) {
+        expression_t expression{};
+        expression.type = expression_type_t::e_binary;
+        expression.op = op;
+        expression.as.binary = { left, right };
+        return add(expression);
+    }
+
+    uint32_t add(expression_t expression) {
+        expressions.push_back(expression);
+        return expressions.size() - 1;
+    }
+
+    uint32_t add(statement_t statement) {
+        statements.push_back(statement);
+        return statements.size() - 1;
+    }
+
+    // empties the ast but keeps the arrays allocated for the next parse
+    void clear() {
+        statements.clear();
+        expressions.clear();
+    }
+
+    std::vector<statement_t> statements;
+    std::vector<expression_t> expressions;
 };
 
-class parser_t {
+static_assert(sizeof(expression_t) == 12 && sizeof(statement_t) == 16);
+static_assert(!std::is_copy_constructible_v<ast_t> && std::is_nothrow_move_constructible_v<ast_t>);
+
+// read only view of an ast_t or of one mapped from a file (see ast_file.hpp), what the interpreter and code gen walk
+struct ast_view_t {
+    ast_view_t() = default;
+    ast_view_t(const ast_t& ast) : statements(ast.statements), expressions(ast.expressions) {}
+    ast_view_t(span_t<const statement_t> statements, span_t<const expression_t> expressions) : statements(statements), expressions(expressions) {}
+
+    // see ast_t::next
+    uint32_t next(uint32_t index) const {
+        const statement_t& statement = statements[index];
+        return statement.type == statement_type_t::e_if ? statement.end : index + 1;
+    }
+
+    span_t<const statement_t> statements;
+    span_t<const expression_t> expressions;
+};
+
+// the symbols of a whole program with the index of the int token declaring each of them
+// collected in one pass before parsing, so that parts of the program can be parsed independently
+struct declarations_t {
+    symbol_table_t symbols;
+    std::vector<uint64_t> tokens;  // by symbol id
+};
+
+struct parsed_t {
+    uint32_t advance;  // tokens the caller still has to step over
+    uint32_t index;    // of the statement or expression, ast_t::npos at the } closing a block
+};
+
+static_assert(sizeof(result_t<parsed_t>) == 16 && std::is_trivially_copyable_v<result_t<parsed_t>>);
+
+// token_source_t is buffer_token_source_t or stream_token_source_t, see lexer.hpp
+template <typename token_source_t>
+class basic_parser_t {
 public:
-    parser_t(const std::vector<token_t>& tokens) : _tokens(tokens) {}
+    template <typename... args_t>
+    basic_parser_t(args_t&&... args) : _tokens(std::forward<args_t>(args)...) {}
 
-    Result<std::pair<ast_t, std::vector<std::string>>, std::string> parse() {
-        ast_t ast{};
-        while (_index < _tokens.size()) {
+    // resolve identifiers against declarations collected ahead of time instead of building a symbol table
+    // the returned symbol table is then empty, declarations must outlive the parse
+    void use_declarations(const declarations_t& declarations) {
+        _declarations = &declarations;
+    }
+
+    // parse into an ast and a symbol table returned by an earlier parse, they are cleared but keep their memory
+    void reuse(ast_t&& ast, symbol_table_t&& symbols) {
+        _ast = std::move(ast);
+        _ast.clear();
+        this->symbols = std::move(symbols);
+        this->symbols.clear();
+    }
+
+    // parse as if name had been declared before the tokens, for a part of a program parsed on its own
+    // the names get the first ids, in the order they are given, it cannot be used with use_declarations
+    // returns false when name was predeclared already
+    bool predeclare(std::string_view name) {
+        return symbols.insert(name).second;
+    }
+
+    // errors carry a code and a source offset, error_t::message formats them when they are reported
+    Result<std::pair<ast_t, symbol_table_t>, error_t> parse() {
+        while (!_tokens.done()) {
             {
                 auto result = parse_statement();
                 if (result) {
-                    auto [advance, statement] = result.unwrap();
-                    _index += advance;
-                    ast.statements.push_back(statement);
+                    auto [advance, statement] = result.value();
+                    if (statement == ast_t::npos) return Err(error(error_code_t::e_unexpected_rbrace));
+                    _tokens.advance(advance);
                     continue;
                 } else {
-                    return Err(result.unwrapErr());
+                    return Err(result.error());
                 }
             }
         }
-        return Ok(std::pair{ast, identifer_table});
+        return Ok(std::pair{ std::move(_ast), std::move(symbols) });
     }
 
 private:
-    std::optional<token_t> try_get(uint32_t offset = 0) {
-        if (_index + offset >= _tokens.size()) return std::nullopt;
-        return _tokens[_index + offset];
+    token_type_t peek(uint32_t offset = 0) {
+        return _tokens.peek(offset);
     }
 
-    Result<std::pair<uint32_t, declaration_t *>, std::string> parse_declaration() {
-        auto token_0 = try_get(0);
-        auto token_1 = try_get(1);
-        auto token_2 = try_get(2);
+    std::string_view text(uint32_t offset = 0) {
+        return _tokens.text(offset);
+    }
 
-        if (token_1 && token_1->type != token_type_t::e_identifier) return Err("expected an identifier"s);
+    // numbers past 32 bits are an error rather than wrapping like the values they compute
+    result_t<uint32_t> parse_number(uint32_t offset = 0) {
+        std::string_view digits = text(offset);
+        uint32_t value = 0;
+        auto [end, ec] = std::from_chars(digits.data(), digits.data() + digits.size(), value);
+        if (ec != std::errc{} || end != digits.data() + digits.size()) return error(error_code_t::e_number_out_of_range, offset);
+        return value;
+    }
+
+    // the id of a variable declared by the current int token, npos if it was declared before
+    uint32_t declare(std::string_view name) {
+        if (!_declarations) {
+            auto [id, inserted] = symbols.insert(name);
+            return inserted ? id : symbol_table_t::npos;
+        }
+        uint32_t id = _declarations->symbols.find(name);
+        if (id != symbol_table_t::npos && _declarations->tokens[id] != _tokens.index()) return symbol_table_t::npos;
+        return id;
+    }
 
-        if (token_2 && token_2->type == token_type_t::e_semicolon) {
-            identifier_t *identifier = pool.alloc<identifier_t>();
-            auto itr = std::find(identifer_table.begin(), identifer_table.end(), token_1->text);
-            if (itr != identifer_table.end()) return Err("Redeclaraing variable"s);
-            identifier->id = std::distance(identifer_table.begin(), itr);
-            identifer_table.push_back(token_1->text);
+    // the id of a variable used by the current token, npos if it is not declared before it
+    uint32_t resolve(std::string_view name) {
+        if (!_declarations) return symbols.find(name);
+        uint32_t id = _declarations->symbols.find(name);
+        if (id != symbol_table_t::npos && _declarations->tokens[id] > _tokens.index()) return symbol_table_t::npos;
+        return id;
+    }
 
-            declaration_t *declaration = pool.alloc<declaration_t>();
-            declaration->type = declaration_type_t::e_simple;
-            declaration->as.simple.identifier = identifier;
+    result_t<parsed_t> parse_declaration() {
+        if (peek(1) != token_type_t::e_identifier) return error(error_code_t::e_expected_identifier, 1);
 
-            return Ok(std::pair{ 3u, declaration });
+        if (peek(2) == token_type_t::e_semicolon) {
+            uint32_t id = declare(text(1));
+            if (id == symbol_table_t::npos) return error(error_code_t::e_redeclared, 1);
 
-        } else if (token_2 && token_2->type == token_type_t::e_assign) {
-            identifier_t *identifier = pool.alloc<identifier_t>();
-            auto itr = std::find(identifer_table.begin(), identifer_table.end(), token_1->text);
-            if (itr != identifer_table.end()) return Err("Redeclaraing variable"s);
-            identifier->id = std::distance(identifer_table.begin(), itr);
-            identifer_table.push_back(token_1->text);
+            uint32_t statement = _ast.add(statement_t{ statement_type_t::e_declaration, id, ast_t::npos, 0 });
+            return parsed_t{ 3u, statement };
 
-            declaration_t *declaration = pool.alloc<declaration_t>();
-            declaration->type = declaration_type_t::e_complex;
-            declaration->as.complex.identifier = identifier;
+        } else if (peek(2) == token_type_t::e_assign) {
+            uint32_t id = declare(text(1));
+            if (id == symbol_table_t::npos) return error(error_code_t::e_redeclared, 1);
 
-            _index += 3;
+            _tokens.advance(3);
 
             auto result = parse_expression();
             if (result) {
-                auto [advance, expression] = result.unwrap();
-                declaration->as.complex.expression = expression;
-                return Ok(std::pair{advance, declaration});
+                auto [advance, expression] = result.value();
+                uint32_t statement = _ast.add(statement_t{ statement_type_t::e_declaration, id, expression, 0 });
+                return parsed_t{ advance, statement };
             } else {
-                return Err(result.unwrapErr());
+                return result.error();
             }
         }
 
-        return Err("unexpected error"s);
+        return error(error_code_t::e_unexpected, 2);
     }
 
-    Result<std::pair<uint32_t, expression_t *>, std::string> parse_expression() {
-        auto token_0 = try_get(0);
-        auto token_1 = try_get(1);
-
-        if (token_1 && (token_1->type == token_type_t::e_semicolon || token_1->type == token_type_t::e_rbrace || token_1->type == token_type_t::e_rbracket)) {
-            // unary expression
-
-            if (token_0->type == token_type_t::e_identifier) {
-                identifier_t *identifier = pool.alloc<identifier_t>();
-                auto itr = std::find(identifer_table.begin(), identifer_table.end(), token_0->text);
-                if (itr == identifer_table.end()) {
-                    return Err("identifier not found"s);
+    // iterative precedence climbing with explicit stacks, one frame per open parenthesis
+    // = binds weakest and is right associative, then ==, then + and -, which are left associative
+    // runs of + and - are kept as signed terms and built into a balanced tree, so long sums stay shallow
+    // stops at the ; } or unmatched ) that ends the expression, the returned advance steps over it
+    result_t<parsed_t> parse_expression() {
+        _frames.push_back({ _terms.size(), _comparisons.size(), _assignments.size(), token_type_t::e_plus });
+        bool expect_operand = true;
+
+        while (true) {
+            token_type_t type = peek(0);
+            frame_t& frame = _frames.back();
+
+            if (expect_operand) {
+                if (type == token_type_t::e_lbracket) {
+                    _frames.push_back({ _terms.size(), _comparisons.size(), _assignments.size(), token_type_t::e_plus });
+                    _tokens.advance(1);
+                    continue;
                 }
-                identifier->id = std::distance(identifer_table.begin(), itr);
-
-                expression_t *expression = pool.alloc<expression_t>();
-                expression->type = expression_type_t::e_unary;
-                expression->as.unary.type = unary_type_t::e_identifier;
-                expression->as.unary.as.identifier = identifier;
 
-                return Ok(std::pair{2u, expression});
-            } else if (token_0->type == token_type_t::e_number) {
-                number_t *number = pool.alloc<number_t>();
-                number->number = std::stoi(token_0->text);
-
-                expression_t *expression = pool.alloc<expression_t>();
-                expression->type = expression_type_t::e_unary;
-                expression->as.unary.type = unary_type_t::e_number;
-                expression->as.unary.as.number = number;
-
-                return Ok(std::pair{2u, expression});
-            }
-        } else {
-            // binary expression
-            if (token_1 && (token_1->type == token_type_t::e_assign || token_1->type == token_type_t::e_plus || token_1->type == token_type_t::e_minus || token_1->type == token_type_t::e_equal)) {
-                expression_t *expression = pool.alloc<expression_t>();
-                expression->type = expression_type_t::e_binary;
-                
-                if (token_0 && token_0->type == token_type_t::e_identifier) {
-                    identifier_t *identifier = pool.alloc<identifier_t>();
-                    auto itr = std::find(identifer_table.begin(), identifer_table.end(), token_0->text);
-                    if (itr == identifer_table.end()) {
-                        return Err("identifier not found"s);
+                uint32_t expression;
+                if (type == token_type_t::e_identifier) {
+                    uint32_t id = resolve(text(0));
+                    if (id == symbol_table_t::npos) {
+                        return fail(error_code_t::e_identifier_not_found);
                     }
-                    identifier->id = std::distance(identifer_table.begin(), itr);
-                    expression->as.binary.left_expression = pool.alloc<expression_t>();
-                    expression->as.binary.left_expression->type = expression_type_t::e_unary;
-                    expression->as.binary.left_expression->as.unary.type = unary_type_t::e_identifier;
-                    expression->as.binary.left_expression->as.unary.as.identifier = identifier;
-                } else if (token_0 && token_0->type == token_type_t::e_number) {
-                    number_t *number = pool.alloc<number_t>();
-                    number->number = std::stoi(token_0->text);
-                    expression->as.binary.left_expression = pool.alloc<expression_t>();
-                    expression->as.binary.left_expression->type = expression_type_t::e_unary;
-                    expression->as.binary.left_expression->as.unary.type = unary_type_t::e_number;
-                    expression->as.binary.left_expression->as.unary.as.number = number;
+                    expression = _ast.add_identifier(id);
+                } else if (type == token_type_t::e_number) {
+                    result_t<uint32_t> number = parse_number(0);
+                    if (!number) return fail(error_code_t::e_number_out_of_range);
+                    expression = _ast.add_number(number.value());
                 } else {
-                    return Err("unexpected token"s);
+                    return fail(error_code_t::e_expected_operand);
                 }
-                
-                expression->as.binary.op = pool.alloc<token_t>(*token_1);
-                
-                _index += 2;  
+                _terms.push_back({ frame.sign, expression });
+                expect_operand = false;
+                _tokens.advance(1);
+                continue;
+            }
 
-                auto result = parse_expression();
-                if (result) {
-                    auto [advance, sub_expression] = result.unwrap();
-                    expression->as.binary.right_expression = sub_expression;
-                    return Ok(std::pair{advance, expression});
-                } else {
-                    return Err(result.unwrapErr());
+            switch (type) {
+                case token_type_t::e_plus:
+                case token_type_t::e_minus:
+                    frame.sign = type;
+                    break;
+                case token_type_t::e_equal:
+                    _comparisons.push_back(close_terms(frame));
+                    frame.sign = token_type_t::e_plus;
+                    break;
+                case token_type_t::e_assign:
+                    _comparisons.push_back(close_terms(frame));
+                    _assignments.push_back(close_comparisons(frame));
+                    frame.sign = token_type_t::e_plus;
+                    break;
+                case token_type_t::e_rbracket:
+                    if (_frames.size() > 1) {
+                        uint32_t expression = close_frame(frame);
+                        if (expression == ast_t::npos) return fail(error_code_t::e_assign_to_non_identifier);
+                        _frames.pop_back();
+                        _terms.push_back({ _frames.back().sign, expression });
+                        _tokens.advance(1);
+                        continue;
+                    }
+                    [[fallthrough]];
+                case token_type_t::e_semicolon:
+                case token_type_t::e_rbrace: {
+                    if (_frames.size() > 1) return fail(error_code_t::e_expected_rbracket);
+                    uint32_t expression = close_frame(frame);
+                    if (expression == ast_t::npos) return fail(error_code_t::e_assign_to_non_identifier);
+                    _frames.pop_back();
+                    return parsed_t{ 1u, expression };
                 }
+                default:
+                    return fail(error_code_t::e_expected_operator);
             }
-
-            // + - == 
-            return Err("unexpected token, should either be ; or a subexpression followed by ;"s);
+            expect_operand = true;
+            _tokens.advance(1);
         }
+    }
+
+    struct frame_t {
+        size_t terms;         // where this frame starts in _terms, _comparisons and _assignments
+        size_t comparisons;
+        size_t assignments;
+        token_type_t sign;    // sign of the next term
+    };
 
-        return Err("expcted ; or an operator"s);
+    error_t error(error_code_t code, uint32_t offset = 0) {
+        return { code, _tokens.position(offset) };
     }
 
-    Result<std::pair<uint32_t, if_t *>, std::string> parse_if() {
-        auto token_0 = try_get(0);
-        auto token_1 = try_get(1);
+    // parse_expression errors, also drops the stacks
+    error_t fail(error_code_t code) {
+        _frames.clear();
+        _terms.clear();
+        _comparisons.clear();
+        _assignments.clear();
+        return error(code);
+    }
 
-        if (token_1 && token_1->type != token_type_t::e_lbracket) return Err("Expected ("s);
+    // sum of _terms[begin, end) with the sign of the first term taken as +
+    // a - b + c - d becomes (a - b) + (c - d), the right half is negated when its first sign differs
+    uint32_t build_terms(size_t begin, size_t end) {
+        if (end - begin == 1) return _terms[begin].second;
+        size_t middle = begin + (end - begin) / 2;
+        op_t op = _terms[begin].first == _terms[middle].first ? op_t::e_plus : op_t::e_minus;
+        uint32_t left = build_terms(begin, middle);
+        uint32_t right = build_terms(middle, end);
+        return _ast.add_binary(left, op, right);
+    }
 
-        _index += 2;
+    uint32_t close_terms(const frame_t& frame) {
+        uint32_t expression = build_terms(frame.terms, _terms.size());
+        _terms.resize(frame.terms);
+        return expression;
+    }
 
-        if_t *_if = pool.alloc<if_t>();
+    uint32_t close_comparisons(const frame_t& frame) {
+        uint32_t expression = _comparisons[frame.comparisons];
+        for (size_t i = frame.comparisons + 1; i < _comparisons.size(); i++) {
+            expression = _ast.add_binary(expression, op_t::e_equal, _comparisons[i]);
+        }
+        _comparisons.resize(frame.comparisons);
+        return expression;
+    }
+
+    // ast_t::npos if something other than an identifier is assigned to
+    uint32_t close_frame(const frame_t& frame) {
+        _comparisons.push_back(close_terms(frame));
+        uint32_t expression = close_comparisons(frame);
+        for (size_t i = _assignments.size(); i-- > frame.assignments;) {
+            uint32_t target = _assignments[i];
+            if (_ast.expressions[target].type != expression_type_t::e_identifier) return ast_t::npos;
+            expression = _ast.add_binary(target, op_t::e_assign, expression);
+        }
+        _assignments.resize(frame.assignments);
+        return expression;
+    }
+
+    // the if is added before its body, its end is filled in at the closing }
+    result_t<parsed_t> parse_if() {
+        if (peek(1) != token_type_t::e_lbracket) return error(error_code_t::e_expected_lbracket, 1);
+
+        _tokens.advance(2);
 
         auto result_expression = parse_expression();
         if (result_expression) {
-            auto [advance, expression] = result_expression.unwrap();
+            auto [advance, expression] = result_expression.value();
             
-            auto last_token = try_get(advance - 1);
-            if (last_token && last_token->type != token_type_t::e_rbracket) return Err("Expected )"s);
+            if (peek(advance - 1) != token_type_t::e_rbracket) return error(error_code_t::e_expected_rbracket, advance - 1);
 
-            _if->expression = expression;
+            uint32_t _if = _ast.add(statement_t{ statement_type_t::e_if, 0, expression, ast_t::npos });
 
-            _index += advance;
+            _tokens.advance(advance);
 
-            auto current_token = try_get(0);
-            if (current_token && current_token->type != token_type_t::e_lbrace) return Err("Expected {"s);
+            if (peek(0) != token_type_t::e_lbrace) return error(error_code_t::e_expected_lbrace);
 
-            _index += 1;
+            _tokens.advance(1);
 
-            while (_index < _tokens.size()) {
+            while (!_tokens.done()) {
                 {
                     auto result = parse_statement();
                     if (result) {
-                        auto [advance, statement] = result.unwrap();
-                        _index += advance;
-                        if (statement) {
-                            _if->truthy.push_back(statement);
+                        auto [advance, statement] = result.value();
+                        _tokens.advance(advance);
+                        if (statement != ast_t::npos) {
                             continue;
                         } else {
-                            return Ok(std::pair{0u, _if});
+                            _ast.statements[_if].end = _ast.statements.size();
+                            return parsed_t{ 0u, _if };
                         }
                     } else {
-                        return Err(result.unwrapErr());
+                        return result.error();
                     }
                 }
             }
             
         }
-        return Err("unparsable if"s);
+        return error(error_code_t::e_unparsable_if);
     }
 
-    Result<std::pair<uint32_t, statement_t *>, std::string> parse_statement() {
-        auto token_0 = try_get(0);
-        if (token_0 && token_0->type == token_type_t::e_int) {
-            auto result = parse_declaration();
-            if (result) {
-                auto [advance, declaration] = result.unwrap();
-                statement_t *statement = pool.alloc<statement_t>();
-                statement->type = statement_type_t::e_declaration;
-                statement->as.declaration = declaration;
-                return Ok(std::pair{advance, statement});
-            } else {
-                return Err(result.unwrapErr());
-            }
+    result_t<parsed_t> parse_statement() {
+        if (peek(0) == token_type_t::e_int) {
+            return parse_declaration();
         } 
 
-        if (token_0 && token_0->type == token_type_t::e_identifier) {
+        if (peek(0) == token_type_t::e_identifier) {
             auto result = parse_expression();
             if (result) {
-                auto [advance, expression] = result.unwrap();
-                statement_t *statement = pool.alloc<statement_t>();
-                statement->type = statement_type_t::e_expression;
-                statement->as.expression = expression;
-                return Ok(std::pair{advance, statement});
+                auto [advance, expression] = result.value();
+                uint32_t statement = _ast.add(statement_t{ statement_type_t::e_expression, 0, expression, 0 });
+                return parsed_t{ advance, statement };
             } else {
-                return Err(result.unwrapErr());
+                return result.error();
             }
         }
 
-        if (token_0 && token_0->type == token_type_t::e_if) {
-            auto result = parse_if();
-            if (result) {
-                auto [advance, _if] = result.unwrap();
-                statement_t *statement = pool.alloc<statement_t>();
-                statement->type = statement_type_t::e_if;
-                statement->as._if = _if;
-                return Ok(std::pair{advance, statement});
-            } else {
-                return Err(result.unwrapErr());
-            }
+        if (peek(0) == token_type_t::e_if) {
+            return parse_if();
         }
 
-        if (token_0 && token_0->type == token_type_t::e_rbrace) {
-            return Ok(std::pair{1u, (statement_t *)nullptr});
+        if (peek(0) == token_type_t::e_rbrace) {
+            return parsed_t{ 1u, ast_t::npos };
         }
-        return Err("unparsable statement"s);
+        return error(error_code_t::e_unparsable_statement);
     }
     
 private:
-    std::vector<token_t> _tokens;
-    uint32_t _index{ 0 };
-    pool_t pool;
+    token_source_t _tokens;
+
+    ast_t _ast;
+    symbol_table_t symbols;
+    const declarations_t *_declarations{ nullptr };
 
-    std::vector<std::string> identifer_table;  // TODO: add 2 maps, name to id, and id to name
+    // parse_expression stacks, kept around so expressions do not allocate once they are warm
+    std::vector<frame_t> _frames;
+    std::vector<std::pair<token_type_t, uint32_t>> _terms;
+    std::vector<uint32_t> _comparisons;
+    std::vector<uint32_t> _assignments;
 };
 
+using parser_t = basic_parser_t<buffer_token_source_t>;
+using stream_parser_t = basic_parser_t<stream_token_source_t>;
+
 } // namespace sl
 
 #endif
\ No newline at end of file
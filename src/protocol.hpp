@@ -0,0 +1,146 @@
+#ifndef PROTOCOL_HPP
+#define PROTOCOL_HPP
+
+// the messages between the compile server (server.hpp) and its client (tools/client.cpp) over a unix socket
+// a connection carries any number of requests, each answered by one response before the next is read:
+//   request:  request_header_t, then length bytes of source or of an absolute path
+//   response: response_header_t, then length bytes of the output or of the error message
+// both ends run on the same machine so the headers are sent in native byte order
+
+#include <cerrno>
+#include <cstdint>
+#include <cstdlib>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#define SL_HAS_UNIX_SOCKETS 1
+#endif
+
+namespace sl::protocol {
+
+inline constexpr uint32_t request_magic = 0x51524c53;   // "SLRQ"
+inline constexpr uint32_t response_magic = 0x53524c53;  // "SLRS"
+inline constexpr uint32_t max_length = 1u << 30;
+
+enum class request_kind_t : uint8_t {
+    e_source,  // the payload is the program
+    e_path,    // the payload is a path the server reads the program from
+};
+
+enum request_flags_t : uint8_t {
+    f_run = 1 << 0,  // compile_options_t::run
+    f_dfa = 1 << 1,  // lexer_engine_t::e_dfa
+    f_ast = 1 << 2,  // compile_options_t::emit_ast
+};
+
+struct request_header_t {
+    uint32_t magic{ request_magic };
+    request_kind_t kind{ request_kind_t::e_source };
+    uint8_t flags{ 0 };
+    uint8_t run_engine{ 0 };  // run_engine_t
+    uint8_t reserved{ 0 };
+    uint32_t length{ 0 };
+};
+
+struct response_header_t {
+    uint32_t magic{ response_magic };
+    uint8_t ok{ 0 };
+    uint8_t cached{ 0 };  // answered from the server's cache
+    uint8_t reserved[2]{};
+    uint32_t length{ 0 };
+    uint32_t reserved2{ 0 };
+    uint64_t lex_ns{ 0 };
+    uint64_t parse_ns{ 0 };
+    uint64_t gen_ns{ 0 };
+    uint64_t total_ns{ 0 };  // from receiving the request to sending the response, reading the file included
+};
+
+static_assert(sizeof(request_header_t) == 12);
+static_assert(sizeof(response_header_t) == 48);
+
+// $SL_SOCKET, or one socket per user in /tmp
+inline std::string default_socket_path() {
+    if (const char *path = std::getenv("SL_SOCKET")) return path;
+#ifdef SL_HAS_UNIX_SOCKETS
+    return "/tmp/simplelang-" + std::to_string(::getuid()) + ".sock";
+#else
+    return "simplelang.sock";
+#endif
+}
+
+#ifdef SL_HAS_UNIX_SOCKETS
+
+inline sockaddr_un socket_address(const std::string& path) {
+    sockaddr_un address{};
+    address.sun_family = AF_UNIX;
+    if (path.size() >= sizeof(address.sun_path)) throw std::runtime_error("socket path too long: " + path);
+    path.copy(address.sun_path, path.size());
+    return address;
+}
+
+// false once the peer is gone
+inline bool write_all(int fd, const void *data, size_t size) {
+    const char *bytes = static_cast<const char *>(data);
+    while (size) {
+        // MSG_NOSIGNAL, a client that went away must not take the server down with SIGPIPE
+        ssize_t sent = ::send(fd, bytes, size, MSG_NOSIGNAL);
+        if (sent < 0 && errno == EINTR) continue;
+        if (sent <= 0) return false;
+        bytes += sent;
+        size -= sent;
+    }
+    return true;
+}
+
+// false on end of file or an error before size bytes came in
+inline bool read_all(int fd, void *data, size_t size) {
+    char *bytes = static_cast<char *>(data);
+    while (size) {
+        ssize_t got = ::recv(fd, bytes, size, 0);
+        if (got < 0 && errno == EINTR) continue;
+        if (got <= 0) return false;
+        bytes += got;
+        size -= got;
+    }
+    return true;
+}
+
+template <typename header_t>
+bool write_message(int fd, header_t header, std::string_view payload) {
+    header.length = uint32_t(payload.size());
+    return write_all(fd, &header, sizeof(header)) && write_all(fd, payload.data(), payload.size());
+}
+
+// the bytes of a message in one buffer, for a peer that sends it without blocking
+template <typename header_t>
+std::string encode_message(header_t header, std::string_view payload) {
+    header.length = uint32_t(payload.size());
+    std::string message(reinterpret_cast<const char *>(&header), sizeof(header));
+    message += payload;
+    return message;
+}
+
+template <typename header_t>
+bool valid_header(const header_t& header, uint32_t magic) {
+    return header.magic == magic && header.length <= max_length;
+}
+
+// the header is checked for its magic and a sane length before the payload is read
+template <typename header_t>
+bool read_message(int fd, uint32_t magic, header_t& header, std::string& payload) {
+    if (!read_all(fd, &header, sizeof(header))) return false;
+    if (!valid_header(header, magic)) return false;
+    payload.resize(header.length);
+    return read_all(fd, payload.data(), payload.size());
+}
+
+#endif
+
+} // namespace sl::protocol
+
+#endif
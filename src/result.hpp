@@ -554,12 +554,12 @@ struct Storage {
 
     void construct(types::Ok<T> ok)
     {
-        new (&storage_) T(ok.val);
+        new (&storage_) T(std::move(ok.val));
         initialized_ = true;
     }
     void construct(types::Err<E> err)
     {
-        new (&storage_) E(err.val);
+        new (&storage_) E(std::move(err.val));
         initialized_ = true;
     }
 
@@ -849,6 +849,21 @@ struct Result {
         std::terminate();
     }
 
+    // moves the value out instead of copying it, for move only payloads, the Result is left holding a moved from value
+    template<typename U = T>
+    typename std::enable_if<
+        !std::is_same<U, void>::value,
+        U
+    >::type
+    take() {
+        if (isOk()) {
+            return std::move(storage().template get<U>());
+        }
+
+        std::fprintf(stderr, "Attempting to take from an error Result\n");
+        std::terminate();
+    }
+
     E unwrapErr() const {
         if (isErr()) {
             return storage().template get<E>();
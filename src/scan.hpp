@@ -0,0 +1,205 @@
+#ifndef SCAN_HPP
+#define SCAN_HPP
+
+// character classification and run scanning for the lexer
+// runs are scanned 16 (sse2) or 32 (avx2) bytes at a time, picked at runtime, with a scalar fallback
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+
+#if defined(__x86_64__) || defined(_M_X64)
+#include <immintrin.h>
+#define SL_SCAN_X86 1
+#endif
+
+namespace sl {
+
+namespace scan {
+
+enum char_class_t : uint8_t {
+    e_space = 1 << 0,  // ' ' \t \n \v \f \r
+    e_alpha = 1 << 1,  // a-z A-Z
+    e_digit = 1 << 2,  // 0-9
+};
+
+// locale independent, unlike isspace / isalpha / isdigit
+inline constexpr std::array<uint8_t, 256> char_classes = [] {
+    std::array<uint8_t, 256> classes{};
+    for (int c = 0; c < 256; c++) {
+        if (c == ' ' || (c >= '\t' && c <= '\r')) classes[c] |= e_space;
+        if ((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z')) classes[c] |= e_alpha;
+        if (c >= '0' && c <= '9') classes[c] |= e_digit;
+    }
+    return classes;
+}();
+
+inline bool is(char c, uint8_t mask) {
+    return char_classes[static_cast<uint8_t>(c)] & mask;
+}
+
+enum class level_t {
+    e_scalar,
+    e_sse2,
+    e_avx2,
+};
+
+// each function returns the first byte in [begin, end) that does not continue the run
+struct scanner_t {
+    const char *(*skip_whitespace)(const char *begin, const char *end);
+    const char *(*skip_alnum)(const char *begin, const char *end);
+    const char *(*skip_digits)(const char *begin, const char *end);
+    const char *(*find_newline)(const char *begin, const char *end);
+};
+
+namespace scalar {
+
+template <uint8_t mask>
+inline const char *skip(const char *begin, const char *end) {
+    while (begin != end && is(*begin, mask)) begin++;
+    return begin;
+}
+
+inline const char *skip_whitespace(const char *begin, const char *end) { return skip<e_space>(begin, end); }
+inline const char *skip_alnum(const char *begin, const char *end) { return skip<e_alpha | e_digit>(begin, end); }
+inline const char *skip_digits(const char *begin, const char *end) { return skip<e_digit>(begin, end); }
+
+inline const char *find_newline(const char *begin, const char *end) {
+    while (begin != end && *begin != '\n') begin++;
+    return begin;
+}
+
+} // namespace scalar
+
+#ifdef SL_SCAN_X86
+
+// the kernels build a mask of bytes that continue the run, the run ends at the first clear bit
+// (x - lo) <= span as unsigned bytes is tested with min_epu8, sse2 and avx2 have no unsigned compare
+
+namespace sse2 {
+
+inline __m128i in_range(__m128i x, char lo, char span) {
+    __m128i shifted = _mm_sub_epi8(x, _mm_set1_epi8(lo));
+    return _mm_cmpeq_epi8(_mm_min_epu8(shifted, _mm_set1_epi8(span)), shifted);
+}
+
+inline __m128i whitespace(__m128i x) {
+    return _mm_or_si128(_mm_cmpeq_epi8(x, _mm_set1_epi8(' ')), in_range(x, '\t', '\r' - '\t'));
+}
+
+inline __m128i digits(__m128i x) {
+    return in_range(x, '0', 9);
+}
+
+inline __m128i alnum(__m128i x) {
+    __m128i lower = _mm_or_si128(x, _mm_set1_epi8(0x20));
+    return _mm_or_si128(in_range(lower, 'a', 25), digits(x));
+}
+
+inline __m128i not_newline(__m128i x) {
+    return _mm_xor_si128(_mm_cmpeq_epi8(x, _mm_set1_epi8('\n')), _mm_set1_epi8(-1));
+}
+
+template <__m128i (*kernel)(__m128i), typename scalar_t>
+inline const char *skip(const char *begin, const char *end, scalar_t tail) {
+    while (end - begin >= 16) {
+        __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i *>(begin));
+        uint32_t mask = ~static_cast<uint32_t>(_mm_movemask_epi8(kernel(x))) & 0xffff;
+        if (mask) return begin + __builtin_ctz(mask);
+        begin += 16;
+    }
+    return tail(begin, end);
+}
+
+inline const char *skip_whitespace(const char *begin, const char *end) { return skip<whitespace>(begin, end, scalar::skip_whitespace); }
+inline const char *skip_alnum(const char *begin, const char *end) { return skip<alnum>(begin, end, scalar::skip_alnum); }
+inline const char *skip_digits(const char *begin, const char *end) { return skip<digits>(begin, end, scalar::skip_digits); }
+inline const char *find_newline(const char *begin, const char *end) { return skip<not_newline>(begin, end, scalar::find_newline); }
+
+} // namespace sse2
+
+namespace avx2 {
+
+#define SL_AVX2 __attribute__((target("avx2")))
+
+SL_AVX2 inline __m256i in_range(__m256i x, char lo, char span) {
+    __m256i shifted = _mm256_sub_epi8(x, _mm256_set1_epi8(lo));
+    return _mm256_cmpeq_epi8(_mm256_min_epu8(shifted, _mm256_set1_epi8(span)), shifted);
+}
+
+SL_AVX2 inline __m256i whitespace(__m256i x) {
+    return _mm256_or_si256(_mm256_cmpeq_epi8(x, _mm256_set1_epi8(' ')), in_range(x, '\t', '\r' - '\t'));
+}
+
+SL_AVX2 inline __m256i digits(__m256i x) {
+    return in_range(x, '0', 9);
+}
+
+SL_AVX2 inline __m256i alnum(__m256i x) {
+    __m256i lower = _mm256_or_si256(x, _mm256_set1_epi8(0x20));
+    return _mm256_or_si256(in_range(lower, 'a', 25), digits(x));
+}
+
+SL_AVX2 inline __m256i not_newline(__m256i x) {
+    return _mm256_xor_si256(_mm256_cmpeq_epi8(x, _mm256_set1_epi8('\n')), _mm256_set1_epi8(-1));
+}
+
+template <__m256i (*kernel)(__m256i), typename scalar_t>
+SL_AVX2 inline const char *skip(const char *begin, const char *end, scalar_t tail) {
+    while (end - begin >= 32) {
+        __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(begin));
+        uint32_t mask = ~static_cast<uint32_t>(_mm256_movemask_epi8(kernel(x)));
+        if (mask) return begin + __builtin_ctz(mask);
+        begin += 32;
+    }
+    return tail(begin, end);
+}
+
+SL_AVX2 inline const char *skip_whitespace(const char *begin, const char *end) { return skip<whitespace>(begin, end, sse2::skip_whitespace); }
+SL_AVX2 inline const char *skip_alnum(const char *begin, const char *end) { return skip<alnum>(begin, end, sse2::skip_alnum); }
+SL_AVX2 inline const char *skip_digits(const char *begin, const char *end) { return skip<digits>(begin, end, sse2::skip_digits); }
+SL_AVX2 inline const char *find_newline(const char *begin, const char *end) { return skip<not_newline>(begin, end, sse2::find_newline); }
+
+#undef SL_AVX2
+
+} // namespace avx2
+
+#endif
+
+inline scanner_t make_scanner(level_t level) {
+    switch (level) {
+#ifdef SL_SCAN_X86
+        case level_t::e_avx2:
+            return { avx2::skip_whitespace, avx2::skip_alnum, avx2::skip_digits, avx2::find_newline };
+        case level_t::e_sse2:
+            return { sse2::skip_whitespace, sse2::skip_alnum, sse2::skip_digits, sse2::find_newline };
+#endif
+        default:
+            return { scalar::skip_whitespace, scalar::skip_alnum, scalar::skip_digits, scalar::find_newline };
+    }
+}
+
+inline level_t best_level() {
+#ifdef SL_SCAN_X86
+    if (__builtin_cpu_supports("avx2")) return level_t::e_avx2;
+    return level_t::e_sse2;
+#else
+    return level_t::e_scalar;
+#endif
+}
+
+inline scanner_t& scanner() {
+    static scanner_t scanner = make_scanner(best_level());
+    return scanner;
+}
+
+// forcing a level is meant for benchmarks and testing the fallbacks, not thread safe
+inline void set_level(level_t level) {
+    scanner() = make_scanner(std::min(level, best_level()));
+}
+
+} // namespace scan
+
+} // namespace sl
+
+#endif
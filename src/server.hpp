@@ -0,0 +1,343 @@
+#ifndef SERVER_HPP
+#define SERVER_HPP
+
+// the compile server of simpleLang --serve, a build that runs the compiler once per file pays for the process
+// start and for growing the token buffer, ast and symbol table on every file, the server pays once
+// the connections are read and written without blocking by one thread polling them, only a request that came in
+// whole goes to the pool, where it takes a warm compiler_t for as long as it compiles, so a client that stays
+// connected, idle or slow, holds no worker; connections past max_connections wait in the listen backlog and one
+// that sends or takes nothing for idle_timeout is closed
+
+#include "compiler.hpp"
+#include "protocol.hpp"
+#include "thread_pool.hpp"
+#include "utility.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#ifdef SL_HAS_UNIX_SOCKETS
+
+#include <poll.h>
+
+namespace sl {
+
+class server_t {
+public:
+    static constexpr size_t max_connections = 256;
+    static constexpr std::chrono::seconds idle_timeout{ 60 };
+
+    // throws when another server already listens on socket_path or the socket cannot be set up
+    // with a cache every request is looked up in it first, see compiler_t::use_cache
+    server_t(std::string socket_path, size_t threads, cache_t *cache = nullptr)
+        : _socket_path(std::move(socket_path)), _cache(cache), _pool(threads) {
+        sockaddr_un address = protocol::socket_address(_socket_path);
+
+        // a socket file nobody accepts on is left over from a server that was killed, anything else is not ours to remove
+        struct stat st{};
+        if (::stat(_socket_path.c_str(), &st) == 0) {
+            if (!S_ISSOCK(st.st_mode)) throw std::runtime_error(_socket_path + " exists and is not a socket");
+            int probe = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+            bool live = probe >= 0 && ::connect(probe, reinterpret_cast<sockaddr *>(&address), sizeof(address)) == 0;
+            if (probe >= 0) ::close(probe);
+            if (live) throw std::runtime_error("a server already listens on " + _socket_path);
+            ::unlink(_socket_path.c_str());
+        }
+
+        if (::pipe2(_wake.fds, O_CLOEXEC | O_NONBLOCK) < 0) throw std::runtime_error(std::string("failed to create a pipe: ") + std::strerror(errno));
+        _fd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC | SOCK_NONBLOCK, 0);
+        if (_fd < 0) throw std::runtime_error(std::string("failed to create a socket: ") + std::strerror(errno));
+        if (::bind(_fd, reinterpret_cast<sockaddr *>(&address), sizeof(address)) < 0 || ::listen(_fd, SOMAXCONN) < 0) {
+            std::string error = std::strerror(errno);
+            ::close(_fd);
+            throw std::runtime_error("failed to listen on " + _socket_path + ": " + error);
+        }
+    }
+
+    server_t(const server_t&) = delete;
+    server_t& operator=(const server_t&) = delete;
+
+    ~server_t() {
+        for (const connection_t& connection : _connections) ::close(connection.fd);
+        ::close(_fd);
+        ::unlink(_socket_path.c_str());
+    }
+
+    // serves until the listening socket fails, which in practice is until the process is killed
+    void run() {
+        std::vector<pollfd> polled;
+        while (true) {
+            clock_t::time_point now = clock_t::now();
+            polled.clear();
+            polled.push_back({ _wake.fds[0], POLLIN, 0 });
+            bool accepting = _connections.size() < max_connections && now >= _accept_paused_until;
+            polled.push_back({ accepting ? _fd : -1, POLLIN, 0 });
+            for (const connection_t& connection : _connections) {
+                // one request at a time, the next one is not read before the answer to the last is sent, and
+                // a compiling connection is left out as poll reports a hang up even when no events are asked for
+                short events = connection.sent < connection.out.size() ? POLLOUT : POLLIN;
+                polled.push_back({ connection.compiling ? -1 : connection.fd, events, 0 });
+            }
+
+            if (::poll(polled.data(), polled.size(), poll_timeout(now)) < 0) {
+                if (errno == EINTR) continue;
+                throw std::runtime_error(std::string("failed to poll: ") + std::strerror(errno));
+            }
+            now = clock_t::now();
+
+            // before the new connections are added, polled has an entry for each of the others
+            for (size_t i = 0; i < _connections.size(); i++) {
+                connection_t& connection = _connections[i];
+                short events = polled[i + 2].revents;
+                if (events & POLLOUT) send(connection, now);
+                if (events & (POLLIN | POLLHUP | POLLERR)) receive(connection, now);
+            }
+            if (polled[0].revents & POLLIN) finish_compiles(now);
+            if (polled[1].revents & POLLIN) accept(now);
+            close_connections(now);
+        }
+    }
+
+private:
+    using clock_t = std::chrono::steady_clock;
+
+    struct connection_t {
+        int fd;
+        std::string in;   // received bytes of requests that have not been answered
+        std::string out;  // the response being sent
+        size_t sent{ 0 };
+        bool compiling{ false };
+        bool ended{ false };        // the peer sent all it will, what came in whole is still answered
+        bool closed{ false };       // the peer went away or broke the protocol, closed once its compile is done
+        clock_t::time_point active;  // of the last byte that came in or went out
+    };
+
+    // closed after _pool is destroyed, its jobs write to it until then
+    struct wake_pipe_t {
+        int fds[2]{ -1, -1 };
+
+        ~wake_pipe_t() {
+            if (fds[0] >= 0) ::close(fds[0]);
+            if (fds[1] >= 0) ::close(fds[1]);
+        }
+    };
+
+    // until the next connection runs out of time
+    int poll_timeout(clock_t::time_point now) const {
+        clock_t::time_point deadline = clock_t::time_point::max();
+        for (const connection_t& connection : _connections) {
+            if (!connection.compiling) deadline = std::min(deadline, connection.active + idle_timeout);
+        }
+        if (now < _accept_paused_until) deadline = std::min(deadline, _accept_paused_until);
+        if (deadline == clock_t::time_point::max()) return -1;
+        return int(std::chrono::duration_cast<std::chrono::milliseconds>(std::max(deadline - now, clock_t::duration::zero())).count()) + 1;
+    }
+
+    void accept(clock_t::time_point now) {
+        while (_connections.size() < max_connections) {
+            int client = ::accept4(_fd, nullptr, nullptr, SOCK_CLOEXEC | SOCK_NONBLOCK);
+            if (client >= 0) {
+                _connections.push_back({ client, {}, {}, 0, false, false, false, now });
+                continue;
+            }
+            if (errno == EMFILE || errno == ENFILE) {
+                // out of descriptors, the pending connections wait until some are closed rather than spin
+                _accept_paused_until = now + std::chrono::seconds(1);
+                return;
+            }
+            if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR || errno == ECONNABORTED) return;
+            throw std::runtime_error(std::string("failed to accept: ") + std::strerror(errno));
+        }
+    }
+
+    void receive(connection_t& connection, clock_t::time_point now) {
+        char buffer[64 * 1024];
+        while (true) {
+            ssize_t got = ::recv(connection.fd, buffer, sizeof(buffer), 0);
+            if (got < 0 && errno == EINTR) continue;
+            if (got < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) break;
+            if (got < 0) {
+                connection.closed = true;
+                return;
+            }
+            if (got == 0) {
+                // a client that shut down its side after the request still waits for the answer
+                connection.ended = true;
+                break;
+            }
+            connection.in.append(buffer, got);
+            connection.active = now;
+        }
+        start_compile(connection);
+    }
+
+    void send(connection_t& connection, clock_t::time_point now) {
+        while (connection.sent < connection.out.size()) {
+            // MSG_NOSIGNAL, a client that went away must not take the server down with SIGPIPE
+            ssize_t sent = ::send(connection.fd, connection.out.data() + connection.sent, connection.out.size() - connection.sent, MSG_NOSIGNAL);
+            if (sent < 0 && errno == EINTR) continue;
+            if (sent < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) return;
+            if (sent <= 0) {
+                connection.closed = true;
+                return;
+            }
+            connection.sent += sent;
+            connection.active = now;
+        }
+        connection.out.clear();
+        connection.sent = 0;
+        // a client may have sent the next request before reading this answer
+        start_compile(connection);
+    }
+
+    // hands the first request of the connection to the pool once all of it came in,
+    // a connection that ended is closed when it has no whole request left and its last answer is sent
+    void start_compile(connection_t& connection) {
+        if (connection.compiling || connection.closed || connection.sent < connection.out.size()) return;
+        protocol::request_header_t request;
+        if (connection.in.size() < sizeof(request)) {
+            connection.closed = connection.ended;
+            return;
+        }
+        std::memcpy(&request, connection.in.data(), sizeof(request));
+        if (!protocol::valid_header(request, protocol::request_magic)) {
+            connection.closed = true;
+            return;
+        }
+        if (connection.in.size() < sizeof(request) + request.length) {
+            connection.closed = connection.ended;
+            return;
+        }
+        std::string payload = connection.in.substr(sizeof(request), request.length);
+        connection.in.erase(0, sizeof(request) + request.length);
+        connection.compiling = true;
+
+        int fd = connection.fd;
+        _pool.submit([this, fd, request, payload = std::move(payload)] {
+            std::string response = answer(request, payload);
+            {
+                std::lock_guard lock{ _compiled_mutex };
+                _compiled.emplace_back(fd, std::move(response));
+            }
+            char byte = 0;
+            (void)!::write(_wake.fds[1], &byte, 1);
+        });
+    }
+
+    // queues the responses of the compiles the pool finished to be sent
+    void finish_compiles(clock_t::time_point now) {
+        char drained[256];
+        while (::read(_wake.fds[0], drained, sizeof(drained)) > 0) {}
+        std::vector<std::pair<int, std::string>> compiled;
+        {
+            std::lock_guard lock{ _compiled_mutex };
+            compiled.swap(_compiled);
+        }
+        for (auto& [fd, response] : compiled) {
+            // a compiling connection is never closed, so its descriptor still names it
+            auto connection = std::find_if(_connections.begin(), _connections.end(), [fd = fd](const connection_t& c) { return c.fd == fd; });
+            connection->compiling = false;
+            connection->active = now;
+            if (connection->closed) continue;
+            connection->out = std::move(response);
+            connection->sent = 0;
+            send(*connection, now);
+        }
+    }
+
+    void close_connections(clock_t::time_point now) {
+        size_t before = _connections.size();
+        auto end = std::remove_if(_connections.begin(), _connections.end(), [now](const connection_t& connection) {
+            if (connection.compiling) return false;
+            if (!connection.closed && now - connection.active < idle_timeout) return false;
+            ::close(connection.fd);
+            return true;
+        });
+        _connections.erase(end, _connections.end());
+        if (_connections.size() < before) _accept_paused_until = clock_t::time_point::min();
+    }
+
+    // on a worker of the pool, the response to request as a message
+    std::string answer(const protocol::request_header_t& request, const std::string& payload) {
+        clock_t::time_point start = clock_t::now();
+        std::unique_ptr<compiler_t> compiler = acquire();
+
+        compile_options_t options;
+        options.run = request.flags & protocol::f_run;
+        options.emit_ast = request.flags & protocol::f_ast;
+        options.engine = request.flags & protocol::f_dfa ? lexer_engine_t::e_dfa : lexer_engine_t::e_hand_written;
+        options.run_engine = request.run_engine <= uint8_t(run_engine_t::e_jit) ? run_engine_t(request.run_engine) : run_engine_t::e_tree;
+
+        auto compile = [&]() -> Result<std::string, std::string> {
+            if (request.kind != protocol::request_kind_t::e_path) return compiler->compile(payload, options);
+            // a relative path would depend on where the server was started, and source_t takes "-" for its own stdin
+            if (!std::filesystem::path(payload).is_absolute()) return Err("the path " + payload + " is not absolute");
+            try {
+                source_t source{ payload };
+                return compiler->compile(source.view(), options);
+            } catch (const std::runtime_error& error) {
+                return Err(std::string(error.what()));
+            }
+        };
+        Result<std::string, std::string> result = compile();
+
+        protocol::response_header_t response;
+        response.ok = bool(result);
+        response.cached = compiler->timings().cached;
+        response.lex_ns = compiler->timings().lex_ns;
+        response.parse_ns = compiler->timings().parse_ns;
+        response.gen_ns = compiler->timings().gen_ns;
+        release(std::move(compiler));
+        response.total_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(clock_t::now() - start).count();
+        return protocol::encode_message(response, result ? result.unwrap() : result.unwrapErr());
+    }
+
+    std::unique_ptr<compiler_t> acquire() {
+        std::lock_guard lock{ _idle_mutex };
+        if (_idle.empty()) {
+            auto compiler = std::make_unique<compiler_t>();
+            compiler->use_cache(_cache);
+            return compiler;
+        }
+        std::unique_ptr<compiler_t> compiler = std::move(_idle.back());
+        _idle.pop_back();
+        return compiler;
+    }
+
+    void release(std::unique_ptr<compiler_t> compiler) {
+        std::lock_guard lock{ _idle_mutex };
+        _idle.push_back(std::move(compiler));
+    }
+
+private:
+    std::string _socket_path;
+    int _fd{ -1 };
+    cache_t *_cache;
+
+    // only touched by the thread in run
+    std::vector<connection_t> _connections;
+    clock_t::time_point _accept_paused_until{ clock_t::time_point::min() };
+
+    std::mutex _idle_mutex;
+    std::vector<std::unique_ptr<compiler_t>> _idle;  // warm compilers of finished compiles, at most one per worker
+
+    std::mutex _compiled_mutex;
+    std::vector<std::pair<int, std::string>> _compiled;  // by connection descriptor, the responses not yet sent
+    wake_pipe_t _wake;  // a byte is written to it for every compile that finished
+
+    thread_pool_t _pool;  // last, its destructor finishes the compiles before the rest goes away
+};
+
+} // namespace sl
+
+#endif
+
+#endif
@@ -0,0 +1,93 @@
+// the library behind simplelang.h, a thin layer over compiler_t that keeps exceptions from crossing the c boundary
+
+#include "simplelang.h"
+
+#include "compiler.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <exception>
+#include <new>
+#include <string>
+
+struct sl_compiler {
+    sl::compiler_t compiler;
+};
+
+namespace {
+
+// copies as much of text as fits and always terminates, a capacity of 0 writes nothing
+void copy_truncated(const std::string& text, char *buffer, size_t capacity) {
+    if (!buffer || capacity == 0) return;
+    size_t size = std::min(text.size(), capacity - 1);
+    std::memcpy(buffer, text.data(), size);
+    buffer[size] = '\0';
+}
+
+} // namespace
+
+extern "C" {
+
+sl_compiler_t *sl_compiler_create(void) {
+    return new (std::nothrow) sl_compiler_t{};
+}
+
+void sl_compiler_destroy(sl_compiler_t *compiler) {
+    delete compiler;
+}
+
+sl_status_t sl_compile(sl_compiler_t *compiler, const char *source, size_t source_size, const sl_options_t *options,
+                       char *output, size_t output_capacity, size_t *output_size,
+                       char *diagnostic, size_t diagnostic_capacity, size_t *diagnostic_size) {
+    if (output_size) *output_size = 0;
+    if (diagnostic_size) *diagnostic_size = 0;
+    copy_truncated({}, diagnostic, diagnostic_capacity);
+    if (!compiler || (!source && source_size) || (!output && output_capacity)) return SL_INVALID_ARGUMENT;
+
+    sl::compile_options_t compile_options;
+    if (options) {
+        compile_options.run = options->run;
+        compile_options.engine = options->lexer_dfa ? sl::lexer_engine_t::e_dfa : sl::lexer_engine_t::e_hand_written;
+        compile_options.emit_ast = options->emit_ast;
+    }
+
+    try {
+        auto result = compiler->compiler.compile(std::string_view(source ? source : "", source_size), compile_options);
+        if (!result) {
+            std::string error = result.unwrapErr();
+            if (diagnostic_size) *diagnostic_size = error.size();
+            copy_truncated(error, diagnostic, diagnostic_capacity);
+            return SL_COMPILE_ERROR;
+        }
+        std::string text = result.unwrap();
+        if (output_size) *output_size = text.size();
+        if (text.size() >= output_capacity) return SL_BUFFER_TOO_SMALL;
+        copy_truncated(text, output, output_capacity);
+        return SL_OK;
+    } catch (const std::bad_alloc&) {
+        return SL_OUT_OF_MEMORY;
+    } catch (const std::exception& error) {
+        // compiler_t reports its own errors as results, anything else still must not unwind into c
+        if (diagnostic_size) *diagnostic_size = std::strlen(error.what());
+        copy_truncated(error.what(), diagnostic, diagnostic_capacity);
+        return SL_COMPILE_ERROR;
+    }
+}
+
+const char *sl_status_string(sl_status_t status) {
+    switch (status) {
+        case SL_OK:
+            return "ok";
+        case SL_COMPILE_ERROR:
+            return "compile error";
+        case SL_BUFFER_TOO_SMALL:
+            return "buffer too small";
+        case SL_INVALID_ARGUMENT:
+            return "invalid argument";
+        case SL_OUT_OF_MEMORY:
+            return "out of memory";
+    }
+    return "unknown status";
+}
+
+} // extern "C"
@@ -0,0 +1,59 @@
+#ifndef SIMPLELANG_H
+#define SIMPLELANG_H
+
+/* the compiler as a library, sources come from memory and the output goes to buffers the caller owns
+ * every sl_compiler_t is independent and keeps its buffers warm between compiles, use one per thread,
+ * a single instance must not be used by two threads at once */
+
+#include <stddef.h>
+
+/* the only symbols a shared build exports */
+#if defined(__GNUC__)
+#define SL_API __attribute__((visibility("default")))
+#else
+#define SL_API
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct sl_compiler sl_compiler_t;
+
+typedef enum sl_status {
+    SL_OK = 0,
+    SL_COMPILE_ERROR,     /* the source does not compile, the diagnostic says why */
+    SL_BUFFER_TOO_SMALL,  /* output_size holds the size needed, compile again with a larger buffer */
+    SL_INVALID_ARGUMENT,
+    SL_OUT_OF_MEMORY,
+} sl_status_t;
+
+typedef struct sl_options {
+    int run;        /* output the state of the program after running it instead of the asm */
+    int lexer_dfa;  /* lex with the table driven engine */
+    int emit_ast;   /* output the binary ast file instead, see ast_file.hpp, output_size is its size */
+} sl_options_t;
+
+/* NULL when out of memory */
+SL_API sl_compiler_t *sl_compiler_create(void);
+SL_API void sl_compiler_destroy(sl_compiler_t *compiler);
+
+/* compiles source_size bytes of source, options may be NULL for the defaults
+ * source may also be an ast file written with emit_ast, at any address, one that is not 8 byte aligned is copied
+ * on SL_OK output holds the asm followed by a NUL, *output_size is its length without the NUL
+ * on SL_BUFFER_TOO_SMALL *output_size is the length of the asm, output_capacity has to be at least one more
+ * on SL_COMPILE_ERROR diagnostic holds "line:column: message", truncated to fit and always NUL terminated,
+ * diagnostic may be NULL, *diagnostic_size is the full length either way when diagnostic_size is not NULL
+ * output_size may be NULL too, output may only be NULL with an output_capacity of 0 */
+SL_API sl_status_t sl_compile(sl_compiler_t *compiler, const char *source, size_t source_size, const sl_options_t *options,
+                              char *output, size_t output_capacity, size_t *output_size,
+                              char *diagnostic, size_t diagnostic_capacity, size_t *diagnostic_size);
+
+/* a short description of a status, never NULL */
+SL_API const char *sl_status_string(sl_status_t status);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,155 @@
+#ifndef SYMBOL_TABLE_HPP
+#define SYMBOL_TABLE_HPP
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace sl {
+
+// interns identifiers, ids are dense and given out in order of insertion
+// so the interpreter and the code generator can index flat arrays with them
+// open addressing with linear probing, the names are copied into blocks that never move
+class symbol_table_t {
+public:
+    static constexpr uint32_t npos = ~0u;
+
+    symbol_table_t() = default;
+
+    // move only like ast_t, moving keeps the blocks in place so the views in _names stay valid
+    symbol_table_t(const symbol_table_t&) = delete;
+    symbol_table_t& operator=(const symbol_table_t&) = delete;
+    symbol_table_t(symbol_table_t&&) = default;
+    symbol_table_t& operator=(symbol_table_t&&) = default;
+
+    uint32_t find(std::string_view name) const {
+        if (_slots.empty()) return npos;
+        uint32_t hash = hash_of(name);
+        for (size_t i = hash & (_slots.size() - 1);; i = (i + 1) & (_slots.size() - 1)) {
+            const slot_t& slot = _slots[i];
+            if (slot.id == npos) return npos;
+            if (slot.hash == hash && _names[slot.id] == name) return slot.id;
+        }
+    }
+
+    // returns the id of name and whether it was newly inserted
+    std::pair<uint32_t, bool> insert(std::string_view name) {
+        if (2 * (_names.size() + 1) > _slots.size()) grow();
+        uint32_t hash = hash_of(name);
+        size_t i = hash & (_slots.size() - 1);
+        for (;; i = (i + 1) & (_slots.size() - 1)) {
+            const slot_t& slot = _slots[i];
+            if (slot.id == npos) break;
+            if (slot.hash == hash && _names[slot.id] == name) return { slot.id, false };
+        }
+        uint32_t id = _names.size();
+        _names.push_back(store(name));
+        _slots[i] = { id, hash };
+        return { id, true };
+    }
+
+    std::string_view name(uint32_t id) const {
+        return _names[id];
+    }
+
+    size_t size() const {
+        return _names.size();
+    }
+
+    // forgets every name but keeps the slots and the first block for the next compile
+    void clear() {
+        std::fill(_slots.begin(), _slots.end(), slot_t{});
+        _names.clear();
+        if (_blocks.size() > 1) {
+            _blocks.resize(1);
+            _block_capacity = block_size;  // the first block holds at least that much
+        }
+        _block_used = 0;
+    }
+
+private:
+    struct slot_t {
+        uint32_t id{ npos };
+        uint32_t hash{ 0 };
+    };
+
+    static constexpr size_t block_size = 16 * 1024;
+
+    static uint32_t hash_of(std::string_view name) {
+        uint64_t hash = 0x9e3779b97f4a7c15ull ^ name.size();
+        size_t i = 0;
+        for (; i + 8 <= name.size(); i += 8) {
+            uint64_t word;
+            std::memcpy(&word, name.data() + i, 8);
+            hash = (hash ^ word) * 0xff51afd7ed558ccdull;
+        }
+        if (i < name.size()) {
+            uint64_t word = 0;
+            std::memcpy(&word, name.data() + i, name.size() - i);
+            hash = (hash ^ word) * 0xff51afd7ed558ccdull;
+        }
+        return uint32_t(hash >> 32) ^ uint32_t(hash);
+    }
+
+    void grow() {
+        std::vector<slot_t> slots(_slots.empty() ? 64 : 2 * _slots.size());
+        for (const slot_t& slot : _slots) {
+            if (slot.id == npos) continue;
+            size_t i = slot.hash & (slots.size() - 1);
+            while (slots[i].id != npos) i = (i + 1) & (slots.size() - 1);
+            slots[i] = slot;
+        }
+        _slots = std::move(slots);
+    }
+
+    std::string_view store(std::string_view name) {
+        if (_blocks.empty() || _block_used + name.size() > _block_capacity) {
+            _block_capacity = std::max(block_size, name.size());
+            _blocks.push_back(std::make_unique<char[]>(_block_capacity));
+            _block_used = 0;
+        }
+        char *copy = _blocks.back().get() + _block_used;
+        std::memcpy(copy, name.data(), name.size());
+        _block_used += name.size();
+        return { copy, name.size() };
+    }
+
+private:
+    std::vector<slot_t> _slots;  // power of 2 sized, at most half full
+    std::vector<std::string_view> _names;  // by id, into _blocks
+    std::vector<std::unique_ptr<char[]>> _blocks;
+    size_t _block_used{ 0 };
+    size_t _block_capacity{ 0 };
+};
+
+// the names of a program by symbol id, of a symbol_table_t or of an ast file (see ast_file.hpp)
+class names_view_t {
+public:
+    names_view_t(const symbol_table_t& symbols) : _symbols(&symbols), _size(symbols.size()) {}
+
+    // name id is chars[offsets[id], offsets[id + 1]), offsets has size + 1 entries
+    names_view_t(const uint32_t *offsets, const char *chars, size_t size) : _offsets(offsets), _chars(chars), _size(size) {}
+
+    std::string_view name(uint32_t id) const {
+        if (_symbols) return _symbols->name(id);
+        return { _chars + _offsets[id], size_t(_offsets[id + 1] - _offsets[id]) };
+    }
+
+    size_t size() const {
+        return _size;
+    }
+
+private:
+    const symbol_table_t *_symbols{ nullptr };
+    const uint32_t *_offsets{ nullptr };
+    const char *_chars{ nullptr };
+    size_t _size;
+};
+
+} // namespace sl
+
+#endif
@@ -0,0 +1,131 @@
+#ifndef THREAD_POOL_HPP
+#define THREAD_POOL_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+namespace sl {
+
+// work stealing pool, every worker has its own queue and takes its newest job first
+// a worker that runs out steals the oldest job of another, so uneven jobs (small and large files) balance out
+// jobs submitted from a worker go to its own queue, others are spread over the queues in turn
+class thread_pool_t {
+public:
+    explicit thread_pool_t(size_t threads = std::thread::hardware_concurrency()) {
+        threads = std::max<size_t>(threads, 1);
+        for (size_t i = 0; i < threads; i++) {
+            _queues.push_back(std::make_unique<queue_t>());
+        }
+        for (size_t i = 0; i < threads; i++) {
+            _threads.emplace_back([this, i] { work(i); });
+        }
+    }
+
+    thread_pool_t(const thread_pool_t&) = delete;
+    thread_pool_t& operator=(const thread_pool_t&) = delete;
+
+    // runs the jobs still queued, then joins
+    ~thread_pool_t() {
+        {
+            std::lock_guard lock{ _mutex };
+            _stop = true;
+        }
+        _ready.notify_all();
+        for (std::thread& thread : _threads) thread.join();
+    }
+
+    template <typename function_t>
+    std::future<std::invoke_result_t<function_t>> submit(function_t&& function) {
+        // std::function has to be copyable, the task is not
+        auto task = std::make_shared<std::packaged_task<std::invoke_result_t<function_t>()>>(std::forward<function_t>(function));
+        std::future<std::invoke_result_t<function_t>> result = task->get_future();
+        push([task] { (*task)(); });
+        return result;
+    }
+
+    size_t size() const {
+        return _threads.size();
+    }
+
+private:
+    struct queue_t {
+        std::mutex mutex;
+        std::deque<std::function<void()>> jobs;
+    };
+
+    void push(std::function<void()> job) {
+        size_t index = _worker_pool == this ? _worker_index : _next_queue++ % _queues.size();
+        {
+            std::lock_guard lock{ _queues[index]->mutex };
+            _queues[index]->jobs.push_back(std::move(job));
+        }
+        {
+            std::lock_guard lock{ _mutex };
+            _pending++;
+        }
+        _ready.notify_one();
+    }
+
+    // own queue from the back, then the others from the front
+    bool pop(size_t self, std::function<void()>& job) {
+        for (size_t i = 0; i < _queues.size(); i++) {
+            queue_t& queue = *_queues[(self + i) % _queues.size()];
+            std::lock_guard lock{ queue.mutex };
+            if (queue.jobs.empty()) continue;
+            if (i == 0) {
+                job = std::move(queue.jobs.back());
+                queue.jobs.pop_back();
+            } else {
+                job = std::move(queue.jobs.front());
+                queue.jobs.pop_front();
+            }
+            return true;
+        }
+        return false;
+    }
+
+    void work(size_t self) {
+        _worker_pool = this;
+        _worker_index = self;
+        while (true) {
+            std::function<void()> job;
+            if (pop(self, job)) {
+                {
+                    std::lock_guard lock{ _mutex };
+                    _pending--;
+                }
+                job();
+                continue;
+            }
+            std::unique_lock lock{ _mutex };
+            _ready.wait(lock, [this] { return _stop || _pending > 0; });
+            if (_stop && _pending == 0) return;
+        }
+    }
+
+private:
+    std::vector<std::unique_ptr<queue_t>> _queues;  // one per worker
+    std::vector<std::thread> _threads;
+    std::atomic<size_t> _next_queue{ 0 };  // for jobs submitted from outside the pool
+
+    std::mutex _mutex;  // guards _pending and _stop, workers sleep on _ready while nothing is pending
+    std::condition_variable _ready;
+    size_t _pending{ 0 };
+    bool _stop{ false };
+
+    static inline thread_local const thread_pool_t *_worker_pool{ nullptr };
+    static inline thread_local size_t _worker_index{ 0 };
+};
+
+} // namespace sl
+
+#endif
@@ -0,0 +1,92 @@
+#ifndef TOKEN_HPP
+#define TOKEN_HPP
+
+#include <cstdint>
+#include <limits>
+#include <string_view>
+#include <vector>
+
+namespace sl {
+
+enum class token_type_t : uint32_t {
+    e_undefined = 0,
+
+    e_int,          // int
+    e_identifier,   // name
+    e_if,           // if
+
+    e_number,       // 8  
+
+    e_assign,       // =
+    e_plus,         // +
+    e_minus,        // -
+    e_equal,        // ==
+    e_lbrace,       // {
+    e_rbrace,       // }
+    e_lbracket,     // (
+    e_rbracket,     // )
+
+    e_semicolon,    // ;
+
+    e_end = std::numeric_limits<uint32_t>::max(),
+};
+
+struct token_t {
+    token_type_t type;
+    uint32_t length;
+    uint64_t offset;  // into the source, 64 bit so streamed sources can be larger than 4 GiB
+
+    std::string_view text(std::string_view src) const {
+        return src.substr(offset, length);
+    }
+};
+
+// tokens stored as a structure of arrays, most lookahead in the parser only needs the type
+struct token_buffer_t {
+    std::vector<token_type_t> types;
+    std::vector<uint32_t> lengths;
+    std::vector<uint64_t> offsets;
+
+    size_t size() const {
+        return types.size();
+    }
+
+    void clear() {
+        types.clear();
+        lengths.clear();
+        offsets.clear();
+    }
+
+    void reserve(size_t count) {
+        types.reserve(count);
+        lengths.reserve(count);
+        offsets.reserve(count);
+    }
+
+    void push_back(const token_t& token) {
+        types.push_back(token.type);
+        lengths.push_back(token.length);
+        offsets.push_back(token.offset);
+    }
+
+    token_t operator[](size_t index) const {
+        return { types[index], lengths[index], offsets[index] };
+    }
+};
+
+enum class lex_status_t {
+    e_token,
+    e_end,   // no more tokens in the input
+    e_more,  // a run reached the end of a partial input, retry from start once more input is available
+};
+
+struct lex_step_t {
+    lex_status_t status;
+    token_type_t type;
+    const char *start;
+    const char *stop;
+};
+
+} // namespace sl
+
+#endif
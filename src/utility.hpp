@@ -3,22 +3,120 @@
 
 #include <filesystem>
 #include <fstream>
+#include <iterator>
+#include <stdexcept>
 #include <string>
+#include <string_view>
+#include <system_error>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define SL_HAS_MMAP 1
+#endif
 
 namespace sl {
-    
-std::string read_file(const std::filesystem::path& filename) {
-    std::ifstream file(filename, std::ios::ate | std::ios::binary);
-    size_t file_size = static_cast<size_t>(file.tellg());
-    std::string buffer;
-    buffer.reserve(file_size);
-    file.seekg(0);
-    size_t counter = 0;
-    while (counter++ != file_size) buffer += file.get();
-    file.close();
-    return buffer;
-}
+
+// read only view of a source file, regular files are mmap'd so loading them does not copy,
+// pipes and stdin ("-") are read in bulk into an owned buffer
+// failing to open or read throws std::system_error with the errno, a std::runtime_error
+class source_t {
+public:
+    explicit source_t(const std::filesystem::path& filename) {
+#ifdef SL_HAS_MMAP
+        int fd = filename == "-" ? STDIN_FILENO : ::open(filename.c_str(), O_RDONLY);
+        if (fd < 0) throw std::system_error(errno, std::generic_category(), "failed to open " + filename.string());
+        // closed however this returns, stdin is left open
+        struct fd_guard_t {
+            int fd;
+            ~fd_guard_t() {
+                if (fd != STDIN_FILENO) ::close(fd);
+            }
+        } guard{ fd };
+
+        struct stat st{};
+        if (::fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0) {
+            void *data = ::mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (data != MAP_FAILED) {
+                ::madvise(data, st.st_size, MADV_SEQUENTIAL);
+                _data = static_cast<const char *>(data);
+                _size = st.st_size;
+                _mapped = true;
+            }
+        }
+        if (!_mapped) read_all(fd, S_ISREG(st.st_mode) ? st.st_size : 0);
+#else
+        std::ifstream file(filename, std::ios::binary);
+        if (!file) throw std::runtime_error("failed to open " + filename.string());
+        _buffer.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+        _data = _buffer.data();
+        _size = _buffer.size();
+#endif
+    }
+
+    source_t(const source_t&) = delete;
+    source_t& operator=(const source_t&) = delete;
+
+    source_t(source_t&& other) noexcept { *this = std::move(other); }
+
+    source_t& operator=(source_t&& other) noexcept {
+        if (this == &other) return *this;
+        release();
+        _buffer = std::move(other._buffer);
+        _mapped = other._mapped;
+        _size = other._size;
+        _data = _mapped ? other._data : _buffer.data();
+        other._data = nullptr;
+        other._size = 0;
+        other._mapped = false;
+        return *this;
+    }
+
+    ~source_t() {
+        release();
+    }
+
+    std::string_view view() const {
+        return { _data, _size };
+    }
+
+private:
+#ifdef SL_HAS_MMAP
+    void read_all(int fd, size_t size_hint) {
+        constexpr size_t block_size = 64 * 1024;
+        _buffer.resize(size_hint ? size_hint : block_size);
+        size_t size = 0;
+        while (true) {
+            if (size == _buffer.size()) _buffer.resize(_buffer.size() * 2);
+            ssize_t count = ::read(fd, _buffer.data() + size, _buffer.size() - size);
+            if (count < 0 && errno == EINTR) continue;
+            if (count < 0) throw std::system_error(errno, std::generic_category(), "failed to read source");
+            if (count == 0) break;
+            size += count;
+        }
+        _buffer.resize(size);
+        _data = _buffer.data();
+        _size = size;
+    }
+#endif
+
+    void release() {
+#ifdef SL_HAS_MMAP
+        if (_mapped) ::munmap(const_cast<char *>(_data), _size);
+#endif
+        _mapped = false;
+    }
+
+private:
+    const char *_data{ nullptr };
+    size_t _size{ 0 };
+    bool _mapped{ false };
+    std::string _buffer;
+};
 
 } // namespace sl
 
-#endif
\ No newline at end of file
+#endif
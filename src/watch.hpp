@@ -0,0 +1,95 @@
+#ifndef WATCH_HPP
+#define WATCH_HPP
+
+// waits for files to be written through inotify, for --watch
+// the directories are watched rather than the files, editors that save by writing a new file and renaming it over
+// the old one replace the inode a watch on the file would be tied to
+
+#if defined(__linux__)
+#define SL_HAS_INOTIFY
+
+#include <cerrno>
+#include <cstring>
+#include <filesystem>
+#include <map>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+
+namespace sl {
+
+class watcher_t {
+public:
+    // throws when inotify is out of watches or a directory cannot be watched
+    explicit watcher_t(const std::vector<std::string>& paths) : _size(paths.size()) {
+        _fd = ::inotify_init1(IN_CLOEXEC);
+        if (_fd < 0) throw std::runtime_error(std::string("failed to start inotify: ") + std::strerror(errno));
+        for (size_t index = 0; index < paths.size(); index++) {
+            std::filesystem::path path = std::filesystem::absolute(paths[index]);
+            std::string directory = path.parent_path().string();
+            int wd = ::inotify_add_watch(_fd, directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO);
+            if (wd < 0) {
+                std::string error = std::strerror(errno);
+                ::close(_fd);
+                throw std::runtime_error("failed to watch " + directory + ": " + error);
+            }
+            _files[{ wd, path.filename().string() }].push_back(index);
+        }
+    }
+
+    watcher_t(const watcher_t&) = delete;
+    watcher_t& operator=(const watcher_t&) = delete;
+
+    ~watcher_t() {
+        ::close(_fd);
+    }
+
+    // blocks until some of the files were written, the indexes of those in the paths given, each once
+    // events that come within settle_ms of each other are taken together, a save is often several of them
+    std::vector<size_t> wait(int settle_ms = 10) {
+        std::vector<bool> changed(_size, false);
+        std::vector<size_t> indexes;
+        int timeout = -1;
+        for (;;) {
+            pollfd poll_fd{ _fd, POLLIN, 0 };
+            int ready = ::poll(&poll_fd, 1, timeout);
+            if (ready < 0 && errno == EINTR) continue;
+            if (ready < 0) throw std::runtime_error(std::string("failed to wait for inotify: ") + std::strerror(errno));
+            if (ready == 0) return indexes;
+
+            alignas(inotify_event) char buffer[4096];
+            ssize_t size = ::read(_fd, buffer, sizeof(buffer));
+            if (size < 0 && errno == EINTR) continue;
+            if (size <= 0) throw std::runtime_error(std::string("failed to read inotify: ") + std::strerror(errno));
+            for (ssize_t offset = 0; offset < size;) {
+                const inotify_event *event = reinterpret_cast<const inotify_event *>(buffer + offset);
+                offset += sizeof(inotify_event) + event->len;
+                if (event->len == 0) continue;
+                auto it = _files.find({ event->wd, std::string(event->name) });
+                if (it == _files.end()) continue;
+                for (size_t index : it->second) {
+                    if (changed[index]) continue;
+                    changed[index] = true;
+                    indexes.push_back(index);
+                }
+            }
+            if (!indexes.empty()) timeout = settle_ms;
+        }
+    }
+
+private:
+    int _fd;
+    size_t _size;  // of the paths given
+    // by watch of the directory and name in it, the same file may be given more than once
+    std::map<std::pair<int, std::string>, std::vector<size_t>> _files;
+};
+
+} // namespace sl
+
+#endif
+
+#endif
@@ -0,0 +1,151 @@
+// thin client of simpleLang --serve, takes the options of simpleLang and compiles through the server instead
+// ./simpleLang-client [--socket <path>] [--timings] [simpleLang options] {path to .sl src}...
+// the socket defaults to $SL_SOCKET or /tmp/simplelang-<uid>.sock, --timings prints what the server spent per input
+
+#include "../src/cli.hpp"
+#include "../src/protocol.hpp"
+#include "../src/utility.hpp"
+
+#include <atomic>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <optional>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+struct reply_t {
+    bool answered{ false };  // false when the request never made it to the server
+    bool ok{ false };
+    std::string text;  // the output or the error
+    sl::protocol::response_header_t header;
+};
+
+int connect_to(const std::string& socket_path) {
+    sockaddr_un address = sl::protocol::socket_address(socket_path);
+    int fd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0) throw std::runtime_error(std::string("failed to create a socket: ") + std::strerror(errno));
+    if (::connect(fd, reinterpret_cast<sockaddr *>(&address), sizeof(address)) < 0) {
+        std::string error = std::strerror(errno);
+        ::close(fd);
+        throw std::runtime_error("failed to connect to " + socket_path + ": " + error);
+    }
+    return fd;
+}
+
+// paths are sent absolute so the server finds them whatever its working directory, stdin is sent as source
+reply_t request(int fd, const std::string& input, const sl::compile_options_t& options) {
+    sl::protocol::request_header_t header;
+    header.flags = (options.run ? sl::protocol::f_run : 0) | (options.engine == sl::lexer_engine_t::e_dfa ? sl::protocol::f_dfa : 0) |
+                   (options.emit_ast ? sl::protocol::f_ast : 0);
+    header.run_engine = uint8_t(options.run_engine);
+    std::string payload;
+    if (input == "-") {
+        sl::source_t source{ input };
+        payload = source.view();
+    } else {
+        header.kind = sl::protocol::request_kind_t::e_path;
+        payload = std::filesystem::absolute(input).string();
+    }
+
+    reply_t reply;
+    if (!sl::protocol::write_message(fd, header, payload) ||
+        !sl::protocol::read_message(fd, sl::protocol::response_magic, reply.header, reply.text)) {
+        throw std::runtime_error("the server closed the connection");
+    }
+    reply.answered = true;
+    reply.ok = reply.header.ok;
+    return reply;
+}
+
+void print_timings(const std::string& input, const sl::protocol::response_header_t& header) {
+    auto us = [](uint64_t ns) { return std::to_string(ns / 1000) + "us"; };
+    std::cerr << input << ": lex " << us(header.lex_ns) << " parse " << us(header.parse_ns)
+              << " gen " << us(header.gen_ns) << " total " << us(header.total_ns) << (header.cached ? " (cached)" : "") << '\n';
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+    // the client's own options are taken out, the rest goes to the usual parser
+    std::string socket_path = sl::protocol::default_socket_path();
+    bool timings = false;
+    std::vector<char *> args{ argv[0] };
+    for (int i = 1; i < argc; i++) {
+        std::string_view arg = argv[i];
+        if (arg == "--socket" && i + 1 < argc) {
+            socket_path = argv[++i];
+        } else if (arg == "--timings") {
+            timings = true;
+        } else {
+            args.push_back(argv[i]);
+        }
+    }
+
+    std::optional<sl::cli_options_t> options = sl::parse_args(int(args.size()), args.data());
+    if (!options || options->serve || options->lsp || options->watch || options->cache_dir || options->stream) {
+        if (options && options->cache_dir) std::cerr << "--cache is an option of the server\n";
+        if (options && options->stream) std::cerr << "--stream is an option of simpleLang, the server reads whole files\n";
+        sl::usage("./simpleLang-client [--socket <path>] [--timings]");
+        exit(EXIT_FAILURE);
+    }
+
+    std::vector<std::filesystem::path> outputs;
+    if (options->output_dir) {
+        std::error_code error_code;
+        std::filesystem::create_directories(*options->output_dir, error_code);
+        if (error_code) {
+            std::cerr << "failed to create " << options->output_dir->string() << ": " << error_code.message() << '\n';
+            return EXIT_FAILURE;
+        }
+        outputs = sl::output_paths(*options);
+    }
+
+    // one connection per thread, the server compiles the connections in parallel
+    const std::vector<std::string>& inputs = options->inputs;
+    std::vector<reply_t> replies(inputs.size());
+    std::vector<std::string> errors(inputs.size());
+    std::atomic<size_t> next{ 0 };
+    auto work = [&] {
+        int fd = -1;
+        for (size_t index; (index = next++) < inputs.size();) {
+            try {
+                if (fd < 0) fd = connect_to(socket_path);
+                replies[index] = request(fd, inputs[index], options->compile);
+                if (!replies[index].ok) {
+                    errors[index] = inputs[index] + ": " + replies[index].text;
+                } else if (options->output_dir) {
+                    std::ofstream file{ outputs[index], std::ios::binary };
+                    if (!file.write(replies[index].text.data(), replies[index].text.size())) {
+                        errors[index] = inputs[index] + ": failed to write " + outputs[index].string();
+                    }
+                    replies[index].text.clear();
+                }
+            } catch (const std::runtime_error& error) {
+                errors[index] = inputs[index] + ": " + error.what();
+            }
+        }
+        if (fd >= 0) ::close(fd);
+    };
+    std::vector<std::thread> threads;
+    for (size_t i = 1; i < std::min(options->jobs, inputs.size()); i++) {
+        threads.emplace_back(work);
+    }
+    work();
+    for (std::thread& thread : threads) thread.join();
+
+    // reported in the order of the inputs, like simpleLang
+    int status = EXIT_SUCCESS;
+    for (size_t i = 0; i < inputs.size(); i++) {
+        if (timings && replies[i].answered) print_timings(inputs[i], replies[i].header);
+        if (!options->output_dir && replies[i].ok) std::cout << replies[i].text;
+        if (errors[i].empty()) continue;
+        std::cerr << errors[i] << '\n';
+        status = EXIT_FAILURE;
+    }
+    return status;
+}